@@ -1,30 +1,59 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <set>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
+
 #include <SFML/System/Clock.hpp>
 #include <SFML/System.hpp>
 
 #include "specificity.h"
+#include "utils/dynamic_bitset.h"
+#include "utils/job_pool.h"
+#include "utils/paged_array.h"
 #include "utils/sparse_array.h"
+#include "utils/stats_segment.h"
 #include "sun_lambda.h"
 
 using byte = uint8_t;
 #define SpecificityDepth 4
 using ScheduleSpecificity = Specificity<SpecificityDepth>;
 
+// Props are stored in a SparseArray unless their type opts into paged storage, which never moves a prop once it is added
+template <typename PropType>
+struct PropStorage { using type = SparseArray<PropType>; };
+
+#define PagedProp(PROP_TYPE) \
+template<> struct PropStorage<PROP_TYPE> { using type = PagedArray<PROP_TYPE>; };
+
+// Resources have exactly one instance per world (Time, Config...), SunLambdas get it passed directly instead of matching it into every novel tuple
+template <typename PropType>
+struct IsResourceProp : std::false_type {};
+
+#define ResourceProp(PROP_TYPE) \
+template<> struct IsResourceProp<PROP_TYPE> : std::true_type {};
+
 /*
  * Bicycle Mango
  * A hopeful gameplay framework
@@ -51,31 +80,132 @@ using ScheduleSpecificity = Specificity<SpecificityDepth>;
 class mango
 {
 public:
-    // The time between the beginning and end of the last loop
-    static inline sf::Time delta;
+    struct World;
+
+    // The time between the beginning and end of the last loop of the world on this thread
+    static inline thread_local sf::Time delta;
 
     static inline sf::Time targetFrameRate = sf::seconds(1.0f/144.0f);
 
-    // Should the Bicycle Mango gameplay loop stop?
-    static inline bool brake = false;
+    // Stop the gameplay loop of the current world, this can be called from any SunLambda including presentation ones
+    static void Brake()
+    {
+        GetWorld().brake.store(true, std::memory_order_relaxed);
+    }
+
+    // Should the gameplay loop of the current world stop? ie while (!mango::Braking()) mango::Loop();
+    static bool Braking()
+    {
+        return GetWorld().brake.load(std::memory_order_relaxed);
+    }
+
+    // Keeps mango::brake = true and while (!mango::brake) working, both act on the current world like Brake and Braking
+    struct BrakeFlag
+    {
+        operator bool() const
+        {
+            return Braking();
+        }
+
+        BrakeFlag& operator=(bool on)
+        {
+            GetWorld().brake.store(on, std::memory_order_relaxed);
+            return *this;
+        }
+    };
+    static inline BrakeFlag brake;
 
     struct SunSchedule
     {
         SunLambda::Id id;
         ScheduleSpecificity specificity;
+        // Run only every interval frames, ie 144 Hz / 14 ~= 10 Hz for AI
+        uint32_t interval = 1;
+        // Spread the novel tuples over this many runs, processing one slice per run round robin
+        uint32_t slices = 1;
+        // The frame (modulo interval) the schedule runs on, so that reduced rate schedules don't all land on the same frame
+        uint32_t phase = 0;
+    };
+
+    static bool RunsOn(const SunSchedule& schedule, uint64_t frame)
+    {
+        return frame % schedule.interval == schedule.phase;
+    }
+
+    // The portion of novel tuples the SunLambda currently being acted iterates
+    struct TupleSlice
+    {
+        uint32_t index = 0;
+        uint32_t count = 1;
+    };
+    static inline thread_local TupleSlice currentSlice{0, 1};
+
+    // The novel tuples [begin, end) acted by a fused schedule, see ActFused
+    struct TupleBlock
+    {
+        size_t begin = 0;
+        size_t end = SIZE_MAX;
     };
-    static inline std::vector<SunSchedule> schedules;
+    static inline thread_local TupleBlock currentBlock{0, SIZE_MAX};
+
+    // The SunLambda being acted on this thread by a schedule, sun_lambda_none between schedules
+    static inline thread_local SunLambda::Id acting = sun_lambda_none;
+
+    static void Act(const SunSchedule& schedule, const SunLambda& lambda, uint64_t onFrame)
+    {
+        if (!RunsOn(schedule, onFrame)) return;
+        currentSlice = {static_cast<uint32_t>((onFrame / schedule.interval) % schedule.slices), schedule.slices};
+        acting = schedule.id;
+        Timed(schedule.id, lambda);
+        acting = sun_lambda_none;
+        // SunLambdas acted outside of the loop always iterate all of their novel tuples
+        currentSlice = TupleSlice{0, 1};
+    }
 
     static void Loop()
     {
+        Loop([](World& world)
+        {
+            for (size_t s = 0; s < world.schedules.size();)
+            {
+                const SunSchedule& schedule = world.schedules[s];
+                if (world.pipelined && IsPresentation(schedule))
+                {
+                    s++;
+                    continue;
+                }
+                world.stage = schedule.specificity.specificity[0];
+                ResumeTasks(world);
+                const size_t run = FusedRun(world, s);
+                if (run > 1)
+                {
+                    ActFused(world, s, run);
+                }
+                else
+                {
+                    Act(schedule, SunLambdaRegistry::GetInstance().Get(schedule.id), world.frame);
+                }
+                s += run;
+            }
+        });
+    }
+
+    // One loop where actFrame acts the SunLambdas in place of the planned schedules, see Pipeline
+    template <typename ActFrame>
+    static void Loop(ActFrame actFrame)
+    {
+        World& world = GetWorld();
         sf::Clock clock;
         auto startTime = clock.getElapsedTime();
+        world.stage = FORAGE;
         CreatePropsDelayed();
-        for (const SunSchedule& schedule : schedules)
-        {
-            SunLambdaRegistry::GetInstance().Get(schedule.id)();
-        }
+        actFrame(world);
+        // Tasks waiting for a stage that has no schedules are resumed once the frame is over
+        world.stage = StageAfterFrame;
+        ResumeTasks(world);
         RemovePropsDelayed();
+        FlushJournal(world);
+        SnapshotMatchStats(world);
 
 #ifdef HOT_RELOAD
         if(ShouldReloadLambdas)
@@ -83,9 +213,22 @@ public:
             ReloadLambdas();
             ShouldReloadLambdas = false;
         }
+        for(const std::string& name : modulesToReload)
+        {
+            ReloadModule(name);
+        }
+        modulesToReload.clear();
 #endif
 
+        if (world.pipelined)
+        {
+            PresentPipelined();
+        }
+        world.frame++;
+        AdvanceEvents(world);
+
         delta = clock.getElapsedTime() - startTime;
+        if (world.stats.IsValid()) PublishStats(world);
         if (delta < targetFrameRate)
         {
             sf::sleep(targetFrameRate - delta);
@@ -95,13 +238,42 @@ public:
 
 #ifdef HOT_RELOAD
     static inline bool ShouldReloadLambdas = false;
+    // Modules to rebuild and reload at the end of this loop, see SunLambdaRegistry::DefineModule
+    static inline std::set<std::string> modulesToReload;
+
     static void ReloadLambdas()
     {
-        SunLambdaRegistry::GetInstance().Unload();
+        // The presentation thread may still be acting functors from the module we're about to unload
+        WaitForPresentation();
+        auto& registry = SunLambdaRegistry::GetInstance();
+        registry.Unload();
 
         system(HOT_RELOAD_CMAKE " --build " HOT_RELOAD_BUILD_PATH " --target " HOT_RELOAD_TARGET);
+        for (auto& [name, lambdaModule] : registry.lambdaModules)
+        {
+            system((std::string(HOT_RELOAD_CMAKE " --build " HOT_RELOAD_BUILD_PATH " --target ") + lambdaModule.target).c_str());
+        }
+
+        registry.Reload();
+    }
+
+    // Only the module's target is rebuilt and only its SunLambdas are rebound, everything else keeps running the code it has loaded
+    // False if no module was defined with this name, see SunLambdaRegistry::DefineModule
+    static bool ReloadModule(const std::string& name)
+    {
+        auto& registry = SunLambdaRegistry::GetInstance();
+        auto lambdaModule = registry.lambdaModules.find(name);
+        if (lambdaModule == registry.lambdaModules.end())
+        {
+            std::cout << "Can't reload " << name << ", no SunLambda module has that name" << std::endl;
+            return false;
+        }
+        WaitForPresentation();
+        registry.Unload(name);
+
+        system((std::string(HOT_RELOAD_CMAKE " --build " HOT_RELOAD_BUILD_PATH " --target ") + lambdaModule->second.target).c_str());
 
-        SunLambdaRegistry::GetInstance().Reload();
+        return registry.Reload(name);
     }
 #endif
 
@@ -125,68 +297,83 @@ public:
         PartialStaticIndicators reuseOnStages;
     };
 
-    // Emerges are called when a novel tuple is formed
-    static inline std::set<SunLambda::Id> emerges;
     static void Emerge(SunLambda::Id id)
     {
-        emerges.insert(id);
+        World& world = GetWorld();
+        Wake(world, id);
+        world.emerges.insert(id);
     }
 
     static void Emerge(std::vector<SunLambda::Id> add)
     {
+        World& world = GetWorld();
         for (SunLambda::Id id : add)
         {
-            emerges.insert(id);
+            Wake(world, id);
+            world.emerges.insert(id);
         }
     }
 
-    // Breakups are called when a one or more of the props in a novel tuple are removed
-    static inline std::set<SunLambda::Id> breakups;
     static void Breakup(SunLambda::Id id)
     {
-        breakups.insert(id);
+        World& world = GetWorld();
+        Wake(world, id);
+        world.breakups.insert(id);
+    }
+
+    /*
+     * Deliver the SunLambda's emerges and breakups once per frame instead of as each tuple forms or breaks
+     * A batch SunLambda (DeclareBatchSunLambda) is called once with every tuple of the frame as columns, the span form of a jolt
+     * A per tuple SunLambda still has its functor called for each tuple, but the prop arrays are looked up once for the whole batch
+     */
+    static void BatchJolts(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        world.batchedJolts.insert(id);
     }
 
     /*
      * Find a prop's raw id from its pointer address and type
      * This is required for storing references to props for access in subsequent SunLambdas
+     * Pointers into a SparseArray are only valid until it next grows, use PagedProp for props whose addresses are kept around
     */
     template <typename T>
     static PropIdRaw GetPropId(void* propAddress)
     {
-        auto& props = GetProps<T>();
-        uintptr_t offset = (reinterpret_cast<uintptr_t>(propAddress) - reinterpret_cast<uintptr_t>(&props.buffer[0]));
-        PropIdRaw pidr = offset/(sizeof(T) + sizeof(bool));
-        return pidr;
+        return GetProps<T>().idOf(static_cast<const T*>(propAddress));
     }
 
-    // Shared between emerge/plan/breakup: we assume a SunLambda cannot have multiple NovelTupleCreators for now
-    static inline std::unordered_map<SunLambda::Id, NovelTupleCreator> novelTupleCreators;
-
-    // This data structure is an augment of potential neighbors when searching for props to form novel tuples
-    static inline std::unordered_map<SunLambda::Id, std::unordered_map<PropTypeId, std::vector<PropIdRaw>>> partialStatics;
-
     struct PlanData
     {
         SunLambda::Id id;
         ScheduleSpecificity specificity;
+        uint32_t interval = 1;
+        uint32_t slices = 1;
     };
 
     static void Plan(std::vector<PlanData> data)
     {
-        for (PlanData& p : data) Plan(p.id, p.specificity);
+        for (PlanData& p : data) Plan(p.id, p.specificity, p.interval, p.slices);
     }
 
-    static void Plan(SunLambda::Id id, const ScheduleSpecificity& specificity)
+    // A SunLambda can be planned to run at a reduced rate (interval) and/or time sliced over its novel tuples (slices)
+    static void Plan(SunLambda::Id id, const ScheduleSpecificity& specificity, uint32_t interval = 1, uint32_t slices = 1)
     {
-        SunSchedule schedule{id, specificity};
+        World& world = GetWorld();
+        Wake(world, id);
+        SunSchedule schedule{id, specificity, std::max(interval, 1u), std::max(slices, 1u)};
+        // Schedules of the same interval take turns on its frames in the order they're planned
+        schedule.phase = std::count_if(world.schedules.begin(), world.schedules.end(), [&schedule](const SunSchedule& planned)
+        {
+            return planned.interval == schedule.interval;
+        }) % schedule.interval;
 
-        auto it = std::upper_bound(schedules.begin(), schedules.end(), schedule,
+        auto it = std::upper_bound(world.schedules.begin(), world.schedules.end(), schedule,
         [](const SunSchedule& a, const SunSchedule& b) -> bool {
             return a.specificity < b.specificity;
         });
 
-        schedules.insert(it, schedule);
+        world.schedules.insert(it, schedule);
     }
 
     template<typename T>
@@ -196,14 +383,12 @@ public:
     // TODO Will we need this later for faster console querying??
 //     using GroupTypeInstance = std::unordered_map<PropTypeId, std::unordered_map<Group, std::set<std::pair<Instance, PropIdRaw>>>>;
 
-    static inline std::unordered_map<PropTypeId, std::unordered_map<PropIdRaw, std::set<Stage>>> ptpsq; // Prop type prop stages query
     // SHOULD WE ONLY STORE THIS INFORMATION FOR PARTIAL STATICS OR EVERYTHING???
 //     static inline std::unordered_map<PropTypeId, std::unordered_map<Group, std::unordered_map<Instance, std::set<PropIdRaw>>>> ptgid;
 
     struct GlobalPropId {PropTypeId typeId; PropIdRaw id;};
     friend inline bool operator< (const GlobalPropId& lhs, const GlobalPropId& rhs){ return lhs.typeId < rhs.typeId && lhs.id < rhs.id; }
 
-
     // Rather ironically, Typeset is a vector because the prop types must be delivered in a certain order to the SunLambda functor despite the conceptual set of props being acted upon
     using Typeset = std::vector<PropTypeId>;
     // All SunLambda and Jolt typeset signatures used (we should only keep track of novel tuples of typesets that are used by gameplay programmers by adding considered typesets in the DefineSunLambda constructor)
@@ -211,18 +396,125 @@ public:
     static inline std::unordered_map<PropTypeId, std::set<Typeset>> mappedPropTupleTypesets;
     static inline std::set<Typeset> globalPropTupleTypesets;
 
-    // Each SunLambda stores a map of props of types in its typeset which have been added but not formed into novel tuples yet
-    // Partial static indicators that return true indicate that a prop can be reused in multiple novel tuples of the same SunLambda
-    static inline std::map<SunLambda::Id, std::unordered_map<PropTypeId, std::vector<PropIdRaw>>> stagingPropTuples;
-
-    static inline std::map<SunLambda::Id, std::vector<std::vector<GlobalPropId>>> novelTuples;
     static inline std::unordered_map<SunLambda::Id, Typeset> sunLambdaTypesets;
     static inline std::map<Typeset, std::vector<SunLambda::Id>> typesetSunLambdas;
 
+    // SunLambda typesets are declared during static initialization and only read afterwards, so every world shares them
+    static const Typeset& TypesetOf(SunLambda::Id id)
+    {
+        static const Typeset none;
+        auto it = sunLambdaTypesets.find(id);
+        return it != sunLambdaTypesets.end() ? it->second : none;
+    }
+
+    static const std::set<Typeset>& TypesetsWithPropType(PropTypeId ptid)
+    {
+        static const std::set<Typeset> none;
+        auto it = mappedPropTupleTypesets.find(ptid);
+        return it != mappedPropTupleTypesets.end() ? it->second : none;
+    }
+
+    static const std::vector<SunLambda::Id>& SunLambdasWithTypeset(const Typeset& typeset)
+    {
+        static const std::vector<SunLambda::Id> none;
+        auto it = typesetSunLambdas.find(typeset);
+        return it != typesetSunLambdas.end() ? it->second : none;
+    }
+
+    // Tags and resources of each SunLambda, they are left out of its typeset
+    static inline std::unordered_map<SunLambda::Id, std::vector<PropTypeId>> sunLambdaTags;
+    static inline std::unordered_map<SunLambda::Id, std::vector<PropTypeId>> sunLambdaResources;
+    // The resources a SunLambda takes by non-const reference
+    static inline std::unordered_map<SunLambda::Id, std::vector<PropTypeId>> sunLambdaWrittenResources;
+
+    static const std::vector<PropTypeId>& TagsOf(SunLambda::Id id)
+    {
+        static const std::vector<PropTypeId> none;
+        auto it = sunLambdaTags.find(id);
+        return it != sunLambdaTags.end() ? it->second : none;
+    }
+
+    // Empty prop types are tags, see Tags
+    template <typename PropType>
+    static constexpr bool IsTag = std::is_empty_v<std::decay_t<PropType>> && !IsResourceProp<std::decay_t<PropType>>::value;
+
+    template <typename PropType>
+    static constexpr bool IsResource = IsResourceProp<std::decay_t<PropType>>::value;
+
+    // Tags and resources are bound once per call rather than stored in novel tuples
+    template <typename PropType>
+    static constexpr bool IsColumn = !IsTag<PropType> && !IsResource<PropType>;
+
+    // The parameters of a SunLambda that have a column in its novel tuples
+    template <typename... PTypes>
+    using Columns = decltype(std::tuple_cat(std::declval<std::conditional_t<IsColumn<PTypes>, std::tuple<PTypes>, std::tuple<>>>()...));
+
+    template <size_t I, typename... PTypes>
+    static constexpr size_t ColumnOf()
+    {
+        constexpr bool columns[] = {IsColumn<PTypes>..., false};
+        size_t column = 0;
+        for (size_t i = 0; i < I; i++)
+        {
+            if (columns[i]) column++;
+        }
+        return column;
+    }
+
+    // Every tag parameter is passed the same instance since tags have no state
+    template <typename PropType>
+    static std::decay_t<PropType>& TagInstance()
+    {
+        static thread_local std::decay_t<PropType> tag;
+        return tag;
+    }
+
+    // The storage of a column or the instance of a tag or resource, bound once for every tuple of a call
+    template <typename PropType>
+    static decltype(auto) BindProp()
+    {
+        if constexpr (IsTag<PropType>)
+        {
+            return (TagInstance<PropType>());
+        }
+        else if constexpr (IsResource<PropType>)
+        {
+            return (presenting ? GetResourceSnapshot<std::decay_t<PropType>>() : GetResource<std::decay_t<PropType>>());
+        }
+        else
+        {
+            return (IterationProps<std::decay_t<PropType>>());
+        }
+    }
+
+    // The argument for parameter I of a SunLambda given the props bound by BindProp, idAt gives the raw id in a column of the tuple being acted
+    template <size_t I, typename... PTypes, typename Props, typename IdAt>
+    static decltype(auto) PropArg(Props& props, const IdAt& idAt)
+    {
+        using PropType = std::tuple_element_t<I, std::tuple<PTypes...>>;
+        if constexpr (!IsColumn<PropType>)
+        {
+            return (std::get<I>(props));
+        }
+        else
+        {
+            return (std::get<I>(props)[idAt(ColumnOf<I, PTypes...>())]);
+        }
+    }
+
     template<typename... PTypes>
     static void ConsiderTypeset(SunLambda::Id id)
     {
-        Typeset typeset = {mango::GetPropTypeId<std::decay_t<PTypes>>()...};
+        Typeset typeset;
+        auto Consider = [&](PropTypeId ptid, bool tag, bool resource, bool written)
+        {
+            if (tag) sunLambdaTags[id].push_back(ptid);
+            else if (resource) sunLambdaResources[id].push_back(ptid);
+            else typeset.push_back(ptid);
+            if (resource && written) sunLambdaWrittenResources[id].push_back(ptid);
+        };
+        (Consider(mango::GetPropTypeId<std::decay_t<PTypes>>(), IsTag<PTypes>, IsResource<PTypes>, IsWrittenProp<PTypes>), ...);
+        (RegisterResource<PTypes>(), ...);
         sunLambdaTypesets[id] = typeset;
         typesetSunLambdas[typeset].push_back(id);
         for (PropTypeId ptid : typeset)
@@ -243,43 +535,80 @@ public:
     static void CallJolt(void (*functor)(PTypes...), SunLambda::Id id, std::vector<PropIdRaw>& sunData, std::index_sequence<Is...> seq)
     {
         std::cout << "Calling jolt with " << sizeof...(PTypes) << " props and " << sunData.size() << " sun data!" << std::endl;
-        functor(GetProps<std::decay_t<PTypes>>()[sunData[Is]]...);
+        auto props = std::forward_as_tuple(BindProp<PTypes>()...);
+        functor(PropArg<Is, PTypes...>(props, [&sunData](size_t column){ return sunData[column]; })...);
     }
 
-    static inline std::unordered_map<PropTypeId, std::function<void(PropIdRaw)>> freeFunctions;
+    // Batch SunLambdas are called with blocks of up to SunBlockSize tuples as one column per parameter, ie (size_t count, Position* positions, const Velocity* velocities)
+    static constexpr size_t SunBlockSize = 16;
 
-    // Prop ----------------
-    static inline std::unordered_map<PropTypeId, std::string> propTypeNames;
+    template <typename... PTypes>
+    using BatchSignature = void(size_t, std::remove_reference_t<PTypes>*...);
+
+    // Each prop array is looked up once for the whole batch
+    template <typename... PTypes>
+    static void CallJoltBatch(void (*functor)(PTypes...), const PropIdRaw* sunData, size_t tupleCount)
+    {
+        CallJoltBatch<PTypes...>(functor, sunData, tupleCount, std::index_sequence_for<PTypes...> {});
+    }
 
+    template <typename... PTypes, std::size_t ... Is>
+    static void CallJoltBatch(void (*functor)(PTypes...), const PropIdRaw* sunData, size_t tupleCount, std::index_sequence<Is...> /*seq*/)
+    {
+        auto props = std::forward_as_tuple(BindProp<PTypes>()...);
+        constexpr size_t width = std::tuple_size_v<Columns<PTypes...>>;
+        for (size_t t = 0; t < tupleCount; t++, sunData += width)
+        {
+            functor(PropArg<Is, PTypes...>(props, [sunData](size_t column){ return sunData[column]; })...);
+        }
+    }
+
+    // Prop ----------------
     template <typename T>
     static PropTypeId GetPropTypeId()
     {
         const PropTypeId id = std::type_index(typeid(std::decay_t<T>)).hash_code();
+        World& world = GetWorld();
+        // Each world registers a prop type the first time it sees it
+        if (world.freeFunctions.count(id)) return id;
         std::string n = std::type_index(typeid(std::decay_t<T>)).name();
         for (size_t i = 0; i < n.size(); i++)
         {
             if (!isdigit(n[i]))
             {
-                propTypeNames[id] = n.substr(i, n.size() - i);
+                world.propTypeNames[id] = n.substr(i, n.size() - i);
                 break;
             }
         }
-        freeFunctions[id] = [&](PropIdRaw pidr){GetProps<T>().free(pidr);};
+        world.freeFunctions[id] = [&](PropIdRaw pidr){GetProps<T>().free(pidr);};
+        world.snapshotFunctions[id] = []{ GetPropsSnapshot<T>() = GetProps<T>(); };
+        world.clearFunctions[id] = []{ GetProps<T>().clear(); };
+        world.memoryFunctions[id] = []{
+            const auto& props = GetProps<T>();
+            return MemoryStats{props.live(), props.capacity(), props.bytes(), props.peak};
+        };
         return id;
     }
 
-    static inline std::unordered_map<Group, IdPool<Instance>> instanceBuffer;
-
     static Stage Next(Group group)
     {
-        return {group, instanceBuffer[group].next()};
+        World& world = GetWorld();
+        return {group, world.instanceBuffer[group].next()};
     }
 
     template<typename PropType>
     static void AddPropStage(PropId<PropType> propId, const Stage& stage)
     {
-        instanceBuffer[stage.group].nextId = stage.instance + 1; // This is kind of a hack, and could cause some large sections of unused ids potentially but I think it will work
-        ptpsq[GetPropTypeId<PropType>()][propId.id].insert(stage);
+        AddPropStage({GetPropTypeId<PropType>(), propId.id}, stage);
+    }
+
+    static void AddPropStage(GlobalPropId gpid, const Stage& stage)
+    {
+        World& world = GetWorld();
+        if (world.ptpsq[gpid.typeId][gpid.id].insert(stage).second) UseStage(world, stage);
+        world.groupProps[stage.group][gpid.typeId].set(gpid.id);
+        NotePeak(world.propStagesPeak, CountPropStages());
+        JournalStage(world, gpid, stage);
 //         ptgid[GetPropTypeId<PropType>()][stage.group][stage.instance].insert(propId.id);
     }
 
@@ -292,28 +621,79 @@ public:
         }
     }
 
+    // Stages can be made up rather than taken from Next, so the instance is claimed from the group when its first prop is staged
+    static void UseStage(World& world, const Stage& stage)
+    {
+        std::vector<uint32_t>& users = world.stageUsers[stage.group];
+        if (stage.instance >= users.size()) users.resize(size_t(stage.instance) + 1, 0);
+        if (users[stage.instance]++ == 0) world.instanceBuffer[stage.group].claim(stage.instance);
+    }
+
+    // The instance is free again once no prop is staged on it
+    static void ReleaseStage(World& world, const Stage& stage)
+    {
+        std::vector<uint32_t>& users = world.stageUsers[stage.group];
+        if (stage.instance < users.size() && users[stage.instance] > 0 && --users[stage.instance] == 0)
+        {
+            world.instanceBuffer[stage.group].free(stage.instance);
+            // The instance may be handed out again, it must not inherit any tags
+            for (auto& [tag, groups] : world.tagStages) SetTag(world, tag, stage, false);
+        }
+    }
+
     struct DelayedPropCreator
     {
         GlobalPropId gpid;
         GroupSet stages;
+        // Set when the group of the prop is destroyed before the prop was created
+        bool cancelled = false;
     };
 
+    // The prop is freed without ever being staged or considered, CreatePropsDelayed skips it
+    static void CancelCreation(World& world, DelayedPropCreator& creator)
+    {
+        creator.cancelled = true;
+        world.freeFunctions[creator.gpid.typeId](creator.gpid.id);
+    }
+
+    // The creator of a prop that was added but not created yet, if any
+    static DelayedPropCreator* FindPendingCreation(World& world, GlobalPropId gpid)
+    {
+        for (size_t i = world.creationCursor; i < world.propsToAdd.size(); i++)
+        {
+            DelayedPropCreator& creator = world.propsToAdd[i];
+            if (!creator.cancelled && creator.gpid.typeId == gpid.typeId && creator.gpid.id == gpid.id) return &creator;
+        }
+        return nullptr;
+    }
+
     static void AddPropStages(DelayedPropCreator& creator)
     {
+        World& world = GetWorld();
         for(const Stage& stage : creator.stages)
         {
-            instanceBuffer[stage.group].nextId = stage.instance + 1; // Should instanceBuffer still be used?
-            ptpsq[creator.gpid.typeId][creator.gpid.id].insert(stage);
+            if (world.ptpsq[creator.gpid.typeId][creator.gpid.id].insert(stage).second) UseStage(world, stage);
+            world.groupProps[stage.group][creator.gpid.typeId].set(creator.gpid.id);
         }
+        NotePeak(world.propStagesPeak, CountPropStages());
+        JournalCreate(world, creator);
     }
 
     template<typename PropType>
     static PropType* InitProp(const GroupSet& stages)
     {
+        static_assert(!IsResource<PropType>, "Resources aren't added to stages, use GetResource");
+        if constexpr (IsTag<PropType>)
+        {
+            World& world = GetWorld();
+            for (const Stage& stage : stages) SetTag(world, GetPropTypeId<PropType>(), stage, true);
+            return &TagInstance<PropType>();
+        }
         auto [id, prop] = GetProps<PropType>().next();
-        PropId<PropType> propId{id};
-        AddPropStages(propId, stages);
-        ConsiderProp({GetPropTypeId<PropType>(), id});
+        DelayedPropCreator creator{{GetPropTypeId<PropType>(), id}, stages};
+        AddPropStages(creator);
+        MarkDirty(creator.gpid.typeId, id);
+        ConsiderProp(creator.gpid);
         return &prop;
     }
 
@@ -321,62 +701,119 @@ public:
     template<typename PropType>
     static PropType* AddProp(const GroupSet& stages)
     {
+        static_assert(!IsResource<PropType>, "Resources aren't added to stages, use GetResource");
+        World& world = GetWorld();
+        if constexpr (IsTag<PropType>)
+        {
+            world.tagsToAdd.push_back({GetPropTypeId<PropType>(), stages});
+            return &TagInstance<PropType>();
+        }
         auto [id, prop] = GetProps<PropType>().next();
         PropId<PropType> propId{id};
-        propsToAdd.push_back({{GetPropTypeId<PropType>(), id}, stages});
+        world.propsToAdd.push_back({{GetPropTypeId<PropType>(), id}, stages});
+        world.queuedCreations++;
         return &prop;
     }
 
+    // Limits how much deferred work CreatePropsDelayed and RemovePropsDelayed do per frame, whatever is left carries over to the next frame
+    struct DelayedBudget
+    {
+        // Props applied per frame, 0 for no limit
+        size_t operations = 0;
+        // Time spent applying props per frame, zero for no limit
+        sf::Time time;
+    };
+
+    // At least one prop is always applied so that a tight budget still makes progress
+    static bool WithinBudget(const DelayedBudget& budget, size_t applied, const sf::Clock& clock)
+    {
+        if (applied == 0) return true;
+        if (budget.operations && applied >= budget.operations) return false;
+        return budget.time == sf::Time::Zero || clock.getElapsedTime() < budget.time;
+    }
+
     static void CreatePropsDelayed()
     {
-        for (DelayedPropCreator& creator : propsToAdd)
+        World& world = GetWorld();
+        // Tags only set bits, so they are never held back by the budget
+        for (auto& [tag, stages] : world.tagsToAdd)
         {
+            for (const Stage& stage : stages) SetTag(world, tag, stage, true);
+        }
+        world.tagsToAdd.clear();
+
+        sf::Clock clock;
+        size_t applied = 0;
+        while (world.creationCursor < world.propsToAdd.size() && WithinBudget(world.createBudget, applied, clock))
+        {
+            // Moved out because jolts called by ConsiderProp may add more props
+            DelayedPropCreator creator = std::move(world.propsToAdd[world.creationCursor++]);
+            applied++;
+            if (creator.cancelled) continue;
             AddPropStages(creator);
+            // A prop that was just added counts as changed for every change tracking SunLambda
+            MarkDirty(creator.gpid.typeId, creator.gpid.id);
             ConsiderProp(creator.gpid);
         }
-        propsToAdd.clear();
+        if (world.creationCursor == world.propsToAdd.size())
+        {
+            world.propsToAdd.clear();
+            world.creationCursor = 0;
+        }
+        world.appliedCreations += applied;
+        FlushJolts(world.pendingEmerges, true);
+        NotifyLanded(world);
     }
 
-    static inline std::vector<DelayedPropCreator> propsToAdd;
-
     static void ConsiderProp(GlobalPropId consider)
     {
+        World& world = GetWorld();
         PropIdRaw id = consider.id;
         PropTypeId propTypeId = consider.typeId;
 
-        GroupSet& stages = ptpsq[propTypeId][id];
-        std::cout << "+" << propTypeNames[propTypeId] << "[" << id << "]" << std::endl;
-        auto typesetsWithAddedPropType = mango::mappedPropTupleTypesets[propTypeId];
+        GroupSet& stages = world.ptpsq[propTypeId][id];
+        std::cout << "+" << world.propTypeNames[propTypeId] << "[" << id << "]" << std::endl;
+        const std::set<Typeset>& typesetsWithAddedPropType = TypesetsWithPropType(propTypeId);
 
         // ---
         for (auto typeset_it = typesetsWithAddedPropType.begin(); typeset_it != typesetsWithAddedPropType.end(); ++typeset_it)
         {
-            for (auto sunlambda_it = typesetSunLambdas[(*typeset_it)].begin();
-                 sunlambda_it != typesetSunLambdas[(*typeset_it)].end(); 
+            for (auto sunlambda_it = SunLambdasWithTypeset((*typeset_it)).begin();
+                 sunlambda_it != SunLambdasWithTypeset((*typeset_it)).end(); 
                 ++sunlambda_it)
             {
         // --- 'for each SunLambda that PropType is a parameter of'
+                if (world.dormant.count(*sunlambda_it))
+                {
+                    world.pendingMatches[*sunlambda_it][propTypeId].push_back(id);
+                    continue;
+                }
+                // SunLambdas sharing a tuple table are matched through the owner of the table
+                if (PlaceTable(world, *sunlambda_it, *typeset_it) != *sunlambda_it) continue;
                 std::cout << "Novel Tuple Search: " << SunLambdaRegistry::GetInstance().Get((*sunlambda_it)).name << std::endl;
+                Count(world.matchCounters.searches);
                 // Check if a novel tuple is formed with this prop from the staged prop neighbors of each SunLambda that propTypeId is in!
                 // Partial statics are not considered as potentialNeighbors because then we'd have to copy the stagingPropTuples vector rather than using a ref
-                std::unordered_map<PropTypeId, std::vector<PropIdRaw>>& potentialNeighbors = mango::stagingPropTuples[(*sunlambda_it)];
+                std::unordered_map<PropTypeId, std::vector<PropIdRaw>>& potentialNeighbors = world.stagingPropTuples[(*sunlambda_it)];
                 // However, both potential neighbors AND partial statics will be added to compatibleNeighbors later in this function
                 std::unordered_map<PropTypeId, std::vector<PropIdRaw>> compatibleNeighbors;
                 bool addedPropFulfillsCompatabilityConstraint = false;
                 bool novelTupleRuledOut = false;
 
-                auto IsPropCompatibleWithSunLambda = [sunlambda_it](PropTypeId ptid, PropIdRaw rid) -> bool
+                auto IsPropCompatibleWithSunLambda = [sunlambda_it, &world](PropTypeId ptid, PropIdRaw rid) -> bool
                 {
-                    std::cout << "Check if " << propTypeNames[ptid] << "[" << rid << "] is compatible with " << SunLambdaRegistry::GetInstance().Get((*sunlambda_it)).name << std::endl;
-                    if (ptpsq[ptid].count(rid)) {
-                        if (!novelTupleCreators[(*sunlambda_it)].compatible)
+                    std::cout << "Check if " << world.propTypeNames[ptid] << "[" << rid << "] is compatible with " << SunLambdaRegistry::GetInstance().Get((*sunlambda_it)).name << std::endl;
+                    if (IsHidden(world, ptid, rid)) return false;
+                    if (world.ptpsq[ptid].count(rid)) {
+                        if (!world.novelTupleCreators[(*sunlambda_it)].compatible)
                         {
                             // The prop was added before this SunLambda was planned!
-                            // TODO: Add novel tuples on SunLambda registry in case tuples were added and staged prior to planning
-                            // Figure out how a CompatibleConstraint should be set prior to planning
+                            // Call Rematch after planning or constraining the SunLambda to rebuild its novel tuples from every prop
                             return true;
                         }
-                        return novelTupleCreators[(*sunlambda_it)].compatible(ptid, ptpsq[ptid][rid]);
+                        if (world.novelTupleCreators[(*sunlambda_it)].compatible(ptid, world.ptpsq[ptid][rid])) return true;
+                        Count(world.matchCounters.constraintFailures);
+                        return false;
                     }
                     return false;
                 };
@@ -391,29 +828,30 @@ public:
                     novelTupleRuledOut = true;
                 }
 
-                NovelTupleCreator& creator = novelTupleCreators[(*sunlambda_it)];
+                NovelTupleCreator& creator = world.novelTupleCreators[(*sunlambda_it)];
                 bool isAddedPropPartialStatic = false;
                 if (!novelTupleRuledOut)
                 {
-                    if (novelTupleCreators.count((*sunlambda_it)) > 0)
+                    if (world.novelTupleCreators.count((*sunlambda_it)) > 0)
                     {
                         if (creator.reuseOnStages.count(propTypeId) > 0) // All props with reuse function are considered partial statics
                         {
-                            std::cout << "Add partial static of type " << propTypeNames[propTypeId] << std::endl;
+                            std::cout << "Add partial static of type " << world.propTypeNames[propTypeId] << std::endl;
                             isAddedPropPartialStatic = true;
-                            partialStatics[(*sunlambda_it)][propTypeId].push_back(id);
+                            world.partialStatics[(*sunlambda_it)][propTypeId].push_back(id);
+                            NotePeak(world.partialStaticPeaks[*sunlambda_it], CountProps(world.partialStatics[*sunlambda_it]));
                         }
                     }
                 }
 
                 std::unordered_map<PropTypeId, PropIdRaw> partialStaticNeighbors;
-                auto FindPartialStatic = [sunlambda_it, &partialStaticNeighbors, &IsPropCompatibleWithSunLambda, &creator, &stages, &propTypeId](PropTypeId ptid)
+                auto FindPartialStatic = [sunlambda_it, &world, &partialStaticNeighbors, &IsPropCompatibleWithSunLambda, &creator, &stages, &propTypeId](PropTypeId ptid)
                 {
-                    for (PropIdRaw ps : partialStatics[*sunlambda_it][ptid])
+                    for (PropIdRaw ps : world.partialStatics[*sunlambda_it][ptid])
                     {
-                        if (creator.reuseOnStages[ptid](stages, propTypeId, ptpsq[propTypeId][ps]))
+                        if (creator.reuseOnStages[ptid](stages, propTypeId, world.ptpsq[propTypeId][ps]))
                         {
-                            std::cout << "Found partial static: " << propTypeNames[ptid] << std::endl;
+                            std::cout << "Found partial static: " << world.propTypeNames[ptid] << std::endl;
                             partialStaticNeighbors[ptid] = ps;
                             return true;
                         }
@@ -451,7 +889,7 @@ public:
                         {
                             if (!FindPartialStatic(ptid))
                             {
-                                std::cout << "FAIL: Cannot find partial static on empty neighbors " << propTypeNames[ptid] << "!" << std::endl;
+                                std::cout << "FAIL: Cannot find partial static on empty neighbors " << world.propTypeNames[ptid] << "!" << std::endl;
                                 novelTupleRuledOut = true;
                                 break;
                             }
@@ -467,7 +905,7 @@ public:
                         if (partialStaticNeighbors.count((*neighbor_it).first)) continue; // If there is a partial static neighbor, let's just use that :)
                         for (auto& neighborId : (*neighbor_it).second)
                         {
-                            std::cout << propTypeNames[(*neighbor_it).first] << " has " << (*neighbor_it).second.size();
+                            std::cout << world.propTypeNames[(*neighbor_it).first] << " has " << (*neighbor_it).second.size();
                             if ((*neighbor_it).second.size() == 1) {
                                 std::cout << " potential neighbor" << std::endl;
                             } else {
@@ -481,7 +919,7 @@ public:
                         }
                         if (compatibleNeighbors[(*neighbor_it).first].empty()) 
                         {
-                            std::cout << "FAIL: Compatible neighbors is empty on " << propTypeNames[(*neighbor_it).first] << " while the prop type being added is " << propTypeNames[propTypeId] << std::endl;
+                            std::cout << "FAIL: Compatible neighbors is empty on " << world.propTypeNames[(*neighbor_it).first] << " while the prop type being added is " << world.propTypeNames[propTypeId] << std::endl;
                             novelTupleRuledOut = true;
                             break; // No compatible neighbors of ptid to pair with
                         }
@@ -519,7 +957,7 @@ public:
                     int v = 0;
                     for (GlobalPropId gpid : novelTuple)
                     {
-                        std::cout << propTypeNames[gpid.typeId] << "[" << gpid.id;
+                        std::cout << world.propTypeNames[gpid.typeId] << "[" << gpid.id;
                         v++;
                         if (v < novelTuple.size())
                         {
@@ -532,12 +970,22 @@ public:
                     novelTuple[addedPropTypeIndex] = {propTypeId, id};
 
     //                 std::cout << "Inserting novel tuple of " << novelTuple.size() << " size" << std::endl;
-                    novelTuples[(*sunlambda_it)].push_back(novelTuple);
+                    InsertTuple(world, *sunlambda_it, novelTuple);
+                    world.tupleVersions[*sunlambda_it]++;
+                    Count(world.matchCounters.matched);
+                    NotePeak(world.novelTuplePeaks[*sunlambda_it], world.novelTuples[*sunlambda_it].size());
                     // This could be optimized with an emerge only sunLambdaTypesets data structure
-                    for (auto emergesun_it = emerges.begin(); emergesun_it != emerges.end(); ++emergesun_it)
+                    for (auto emergesun_it = world.emerges.begin(); emergesun_it != world.emerges.end(); ++emergesun_it)
                     {
-                        if (sunLambdaTypesets[(*emergesun_it)] == (*typeset_it))
+                        if (TypesetOf((*emergesun_it)) == (*typeset_it))
                         {
+                            if (world.batchedJolts.count(*emergesun_it))
+                            {
+                                std::vector<size_t>& pending = world.pendingEmerges[*emergesun_it];
+                                for (GlobalPropId& gpid : novelTuple)
+                                    pending.push_back(gpid.id);
+                                break;
+                            }
                             std::vector<PropIdRaw> sunData; // The SunLambda already knows the types in order, therefore we only need pass it the PropIdRaw values and it can imply the types
                             for (GlobalPropId& gpid : novelTuple)
                                 sunData.push_back(gpid.id);
@@ -551,8 +999,10 @@ public:
                 {
                     if (addedPropFulfillsCompatabilityConstraint && !isAddedPropPartialStatic)
                     {
-                        std::cout << "Staging " << propTypeNames[propTypeId] << "[" << id << "] on " << SunLambdaRegistry::SunLambdaRegistry::GetInstance().Get(*sunlambda_it).name << std::endl;
-                        mango::stagingPropTuples[(*sunlambda_it)][propTypeId].push_back(id);
+                        std::cout << "Staging " << world.propTypeNames[propTypeId] << "[" << id << "] on " << SunLambdaRegistry::SunLambdaRegistry::GetInstance().Get(*sunlambda_it).name << std::endl;
+                        world.stagingPropTuples[(*sunlambda_it)][propTypeId].push_back(id);
+                        Count(world.matchCounters.staged);
+                        NotePeak(world.stagingPeaks[*sunlambda_it], CountProps(world.stagingPropTuples[*sunlambda_it]));
                     }
                 }
             } // --- end sunlambda_it
@@ -562,28 +1012,133 @@ public:
     // Props should only be removed by stage rather than considering type
     using PropRemovalSearch = std::function<bool(std::set<Stage>&)>;
 
-    // Delay prop removal until the end of the current frame
-    static inline std::unordered_map<PropTypeId, std::set<PropIdRaw>> propsToRemove;
-
-    static inline std::unordered_map<SunLambda::Id, std::set<size_t>> tuplesToBreakup;
-
     static void RemoveProps(PropRemovalSearch Remove)
     {
-        for (auto& propCategory : propTypeNames)
+        World& world = GetWorld();
+        for (auto& propCategory : world.propTypeNames)
         {
             PropTypeId propTypeId = propCategory.first;
-            for (auto& propData: ptpsq[propTypeId])
+            for (auto& propData: world.ptpsq[propTypeId])
             {
                 if (Remove(propData.second))
                 {
-                    propsToRemove[propTypeId].insert(propData.first);
+                    QueueRemoval(world, propTypeId, propData.first);
                 }
             }
         }
-        for (auto& propTypeProps : propsToRemove)
+        for (auto& [tag, groups] : world.tagStages)
+        {
+            for (auto& [group, instances] : groups)
+            {
+                instances.forEach([&, tag = tag, group = group](size_t instance)
+                {
+                    std::set<Stage> stages = {{group, static_cast<Instance>(instance)}};
+                    if (Remove(stages)) world.tagsToRemove.push_back({tag, *stages.begin()});
+                });
+            }
+        }
+    }
+
+    static void QueueRemoval(World& world, PropTypeId ptid, PropIdRaw pidr)
+    {
+        if (!world.propsToRemove[ptid].insert(pidr).second) return;
+        world.removalQueue.push_back({ptid, pidr});
+        world.queuedRemovals++;
+    }
+
+    static bool IsHidden(World& world, PropTypeId ptid, PropIdRaw pidr)
+    {
+        if (world.removalCursor == world.removalQueue.size()) return false;
+        auto hidden = world.hiddenProps.find(ptid);
+        return hidden != world.hiddenProps.end() && hidden->second.test(pidr);
+    }
+
+    static inline size_t GetTypesetIndex(SunLambda::Id sunid, PropTypeId ptid)
+    {
+        size_t i = 0;
+        for (const PropTypeId& seek_ptid : TypesetOf(sunid))
+        {
+            if (seek_ptid == ptid) return i;
+            i++;
+        }
+        return i;
+    }
+
+    // With a time budget removals are applied in chunks, each chunk scans the novel tuples of SunLambdas with the removed prop types
+    static constexpr size_t RemovalChunk = 256;
+
+    static void RemovePropsDelayed()
+    {
+        World& world = GetWorld();
+        for (auto& [tag, stage] : world.tagsToRemove) SetTag(world, tag, stage, false);
+        world.tagsToRemove.clear();
+
+        sf::Clock clock;
+        const DelayedBudget& budget = world.removeBudget;
+        size_t applied = 0;
+        while (world.removalCursor < world.removalQueue.size() && WithinBudget(budget, applied, clock))
+        {
+            size_t chunk = world.removalQueue.size() - world.removalCursor;
+            if (budget.time != sf::Time::Zero) chunk = std::min(chunk, RemovalChunk);
+            if (budget.operations) chunk = std::min(chunk, std::max<size_t>(1, budget.operations - std::min(applied, budget.operations)));
+            // Each chunk scans the affected tuple tables, so a destroyed group is removed in a single chunk however large it is
+            if (world.removalCursor < world.unsplitRemovals) chunk = std::max(chunk, world.unsplitRemovals - world.removalCursor);
+            ApplyRemovals(world, chunk);
+            applied += chunk;
+        }
+        if (world.removalCursor == world.removalQueue.size())
+        {
+            world.removalQueue.clear();
+            world.removalCursor = 0;
+            world.unsplitRemovals = 0;
+        }
+        else
+        {
+            // Removals carried over to the next frame hide their props from SunLambdas until they are applied
+            for (size_t i = world.removalCursor; i < world.removalQueue.size(); i++)
+            {
+                world.hiddenProps[world.removalQueue[i].typeId].set(world.removalQueue[i].id);
+            }
+        }
+        NotifyLanded(world);
+    }
+
+    // Every SunLambda sharing the table breaks up with the tuple, batched ones when pendingBreakups is next flushed
+    static void BreakupTuple(World& world, SunLambda::Id table, const std::vector<GlobalPropId>& tuple)
+    {
+        for (SunLambda::Id sharer : SharersOf(world, table))
+        {
+            if (!world.breakups.count(sharer)) continue;
+            if (world.batchedJolts.count(sharer))
+            {
+                std::vector<size_t>& pending = world.pendingBreakups[sharer];
+                for (const GlobalPropId& gpid : tuple)
+                    pending.push_back(gpid.id);
+            }
+            else
+            {
+                std::vector<PropIdRaw> sunData; // The SunLambda already knows the types in order, therefore we only need pass it the PropIdRaw values and it can imply the types
+                for (const GlobalPropId& gpid : tuple)
+                    sunData.push_back(gpid.id);
+                SunLambda& sun = SunLambdaRegistry::GetInstance().Get(sharer);
+                sun.Breakup(sunData);
+            }
+        }
+    }
+
+    static void ApplyRemovals(World& world, size_t count)
+    {
+        std::unordered_map<PropTypeId, std::set<PropIdRaw>> removing;
+        for (size_t i = 0; i < count; i++)
+        {
+            const GlobalPropId& gpid = world.removalQueue[world.removalCursor++];
+            removing[gpid.typeId].insert(gpid.id);
+        }
+
+        for (auto& propTypeProps : removing)
         {
             // Find the Typesets that contain this proptypeid
-            for (const Typeset& typeset : mappedPropTupleTypesets[propTypeProps.first])
+            for (const Typeset& typeset : TypesetsWithPropType(propTypeProps.first))
             {
                 size_t typesetRemovalIndex = 0;
                 for (size_t i = 0; i < typeset.size(); i++)
@@ -594,101 +1149,202 @@ public:
                         break;
                     }
                 }
-                for (SunLambda::Id& sun : typesetSunLambdas[typeset])
+                for (const SunLambda::Id& sun : SunLambdasWithTypeset(typeset))
                 {
                     size_t index = 0;
-                    for (auto& novelTuple : novelTuples[sun])
+                    for (auto& novelTuple : world.novelTuples[sun])
                     {
                         if (propTypeProps.second.count(novelTuple[typesetRemovalIndex].id))
                         {
-                            tuplesToBreakup[sun].insert(index);
+                            world.tuplesToBreakup[sun].insert(index);
                         }
                         index++;
                     }
+                    // Props that never made it into a novel tuple are still waiting in staging or partial statics
+                    auto Purge = [&propTypeProps](std::vector<PropIdRaw>& ids)
+                    {
+                        ids.erase(std::remove_if(ids.begin(), ids.end(), [&](PropIdRaw pidr){ return propTypeProps.second.count(pidr) > 0; }), ids.end());
+                    };
+                    Purge(world.stagingPropTuples[sun][propTypeProps.first]);
+                    Purge(world.partialStatics[sun][propTypeProps.first]);
+                    auto pending = world.pendingMatches.find(sun);
+                    if (pending != world.pendingMatches.end()) Purge(pending->second[propTypeProps.first]);
                 }
             }
         }
-    }
-
-    static inline size_t GetTypesetIndex(SunLambda::Id sunid, PropTypeId ptid)
-    {
-        size_t i = 0;
-        for (PropTypeId& seek_ptid : sunLambdaTypesets[sunid])
-        {
-            if (seek_ptid == ptid) return i;
-            i++;
-        }
-        return i;
-    }
 
-    static void RemovePropsDelayed()
-    {
-        // TODO:
-        for (auto& broken : tuplesToBreakup)
+        // Tuples formed since the last CreatePropsDelayed (ie by InitProp) emerge before any of them can break up
+        FlushJolts(world.pendingEmerges, true);
+        for (auto& broken : world.tuplesToBreakup)
         {
+            auto& tuples = world.novelTuples[broken.first];
             for (auto tuple_it = broken.second.rbegin(); tuple_it != broken.second.rend(); ++tuple_it)
             {
-                // TODO: make this more efficient by swapping values to end and then erasing ending range
-                auto tuple = novelTuples[broken.first].begin() + (*tuple_it);
+                auto tuple = tuples.begin() + (*tuple_it);
                 // Iterate through the tuple, checking and removing any partial static if it is contained in propsToRemove
                 for (GlobalPropId& gpid : *tuple)
                 {
-                    bool shouldRemoveProp = propsToRemove.count(gpid.typeId) && propsToRemove[gpid.typeId].count(gpid.id);
+                    bool shouldRemoveProp = removing.count(gpid.typeId) && removing[gpid.typeId].count(gpid.id);
                     if (shouldRemoveProp)
                     {
                         // Does this SunLambda have any partial static of this prop type
                         // Can you have partial statics and consumed props of the same type?
-                        if (partialStatics.count(broken.first) && partialStatics[broken.first].count(gpid.typeId))
+                        if (world.partialStatics.count(broken.first) && world.partialStatics[broken.first].count(gpid.typeId))
                         {
-                            auto& pss = partialStatics[broken.first][gpid.typeId];
+                            auto& pss = world.partialStatics[broken.first][gpid.typeId];
                             auto s_it = std::find(pss.begin(), pss.end(), gpid.id);
                             if (s_it != pss.end()) pss.erase(s_it);
                         }
                     } else
                     {
-                        bool isPartialStatic = novelTupleCreators[broken.first].reuseOnStages.count(gpid.typeId) > 0;
-                        if (!isPartialStatic)
+                        bool isPartialStatic = world.novelTupleCreators[broken.first].reuseOnStages.count(gpid.typeId) > 0;
+                        // Props waiting for a later removal chunk are not restaged
+                        if (!isPartialStatic && !IsHidden(world, gpid.typeId, gpid.id))
                         {
                             // If the prop is not removed, but the tuple is broken, we should restage it
-                            std::cout << "Restage prop of type " << propTypeNames[gpid.typeId] << " on SunLambda " << SunLambdaRegistry::GetInstance().Get(broken.first).name << std::endl;
-                            mango::stagingPropTuples[broken.first][gpid.typeId].push_back(gpid.id);
+                            std::cout << "Restage prop of type " << world.propTypeNames[gpid.typeId] << " on SunLambda " << SunLambdaRegistry::GetInstance().Get(broken.first).name << std::endl;
+                            world.stagingPropTuples[broken.first][gpid.typeId].push_back(gpid.id);
+                            Count(world.matchCounters.restaged);
+                            NotePeak(world.stagingPeaks[broken.first], CountProps(world.stagingPropTuples[broken.first]));
                         }
                     }
                 }
                 
-                if (breakups.count(broken.first))
+                BreakupTuple(world, broken.first, *tuple);
+            }
+            // The broken tuples are compacted out in one pass, keeping the order of the rest for sorted SunLambdas
+            auto order = world.sortOrders.find(broken.first);
+            if (order != world.sortOrders.end())
+            {
+                // Appended tuples that broke up no longer wait to be sorted
+                const size_t appended = tuples.size() - std::min(order->second.unsorted, tuples.size());
+                order->second.unsorted -= std::min<size_t>(order->second.unsorted, std::distance(broken.second.lower_bound(appended), broken.second.end()));
+            }
+            auto next = broken.second.begin();
+            size_t kept = 0;
+            for (size_t t = 0; t < tuples.size(); t++)
+            {
+                if (next != broken.second.end() && *next == t)
                 {
-                    std::vector<PropIdRaw> sunData; // The SunLambda already knows the types in order, therefore we only need pass it the PropIdRaw values and it can imply the types
-                    for (GlobalPropId& gpid : (*tuple))
-                        sunData.push_back(gpid.id);
-                    SunLambda& sun = SunLambdaRegistry::GetInstance().Get(broken.first);
-                    sun.Breakup(sunData);
-                    break;
+                    ++next;
+                    continue;
                 }
-                novelTuples[broken.first].erase(tuple);
+                if (kept != t) tuples[kept] = std::move(tuples[t]);
+                kept++;
             }
+            tuples.resize(kept);
+            world.tupleVersions[broken.first]++;
         }
+        // Breakups must see their props before they are freed
+        FlushJolts(world.pendingBreakups, false);
 
-        for (auto& propData : propsToRemove)
+        for (auto& propData : removing)
         {
             for (const PropIdRaw& propId : propData.second)
             {
+                world.propsToRemove[propData.first].erase(propId);
+                world.hiddenProps[propData.first].reset(propId);
+                JournalRemove(world, {propData.first, propId});
                 // Condense pool by reuse
-                freeFunctions[propData.first](propId);
+                world.freeFunctions[propData.first](propId);
+                // The raw id may be reused by a new prop which will mark itself dirty when it is created
+                auto subscribers = world.dirtyProps.find(propData.first);
+                if (subscribers != world.dirtyProps.end())
+                {
+                    for (auto& [sunid, dirty] : subscribers->second) dirty.reset(propId);
+                }
                 // Make stages used by prop available
-                for (auto& stage : ptpsq[propData.first][propId])
+                for (auto& stage : world.ptpsq[propData.first][propId])
                 {
-                    instanceBuffer[stage.group].free(stage.instance);
+                    world.groupProps[stage.group][propData.first].reset(propId);
+                    // A destroyed group gets all of its instances back at once when its destruction lands
+                    if (!world.destroyingGroups.count(stage.group))
+                    {
+                        ReleaseStage(world, stage);
+                    }
                 }
-                ptpsq[propData.first].erase(propId);
+                world.ptpsq[propData.first].erase(propId);
             }
-            if (ptpsq[propData.first].size() == 0)
+            if (world.ptpsq[propData.first].size() == 0)
             {
-                ptpsq.erase(propData.first);
+                world.ptpsq.erase(propData.first);
             }
         }
-        propsToRemove.clear();
-        tuplesToBreakup.clear();
+        world.tuplesToBreakup.clear();
+        world.appliedRemovals += count;
+    }
+
+    // A PropBatch covers every prop added or removed before it was marked
+    struct PropBatch
+    {
+        uint64_t creations = 0;
+        uint64_t removals = 0;
+    };
+
+    static PropBatch MarkPropBatch()
+    {
+        World& world = GetWorld();
+        return {world.queuedCreations, world.queuedRemovals};
+    }
+
+    // Have all the additions and removals of the batch been applied?
+    static bool HasLanded(const PropBatch& batch)
+    {
+        World& world = GetWorld();
+        return world.appliedCreations >= batch.creations && world.appliedRemovals >= batch.removals;
+    }
+
+    // The callback is called at the end of the CreatePropsDelayed or RemovePropsDelayed that lands the batch
+    static void OnLanded(const PropBatch& batch, std::function<void()> callback)
+    {
+        if (HasLanded(batch))
+        {
+            callback();
+            return;
+        }
+        GetWorld().landingCallbacks.push_back({batch, std::move(callback)});
+    }
+
+    static void NotifyLanded(World& world)
+    {
+        if (world.landingCallbacks.empty()) return;
+        // Callbacks may mark new batches, so take the landed ones out first
+        std::vector<std::function<void()>> landed;
+        auto& pending = world.landingCallbacks;
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (HasLanded(it->first))
+            {
+                landed.push_back(std::move(it->second));
+                it = pending.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (auto& callback : landed) callback();
+    }
+
+
+    static void FlushJolts(std::unordered_map<SunLambda::Id, std::vector<size_t>>& pending, bool emerge)
+    {
+        for (auto& [sunid, sunData] : pending)
+        {
+            const size_t tupleSize = TypesetOf(sunid).size();
+            if (sunData.empty() || tupleSize == 0) continue;
+            SunLambda& sun = SunLambdaRegistry::GetInstance().Get(sunid);
+            if (emerge)
+            {
+                sun.EmergeBatch(sunData.data(), sunData.size() / tupleSize);
+            }
+            else
+            {
+                sun.BreakupBatch(sunData.data(), sunData.size() / tupleSize);
+            }
+            // Keep the capacity around for the next frame
+            sunData.clear();
+        }
     }
 
     // GetPropTypeId<PropType>
@@ -697,20 +1353,117 @@ public:
     // Let's start over
     static void ResetProps()
     {
-        ptpsq.clear();
-        partialStatics.clear();
-        stagingPropTuples.clear();
-        novelTuples.clear();
-        instanceBuffer.clear();
+        World& world = GetWorld();
+        // Prop arrays keep their capacity for the next batch of props
+        for (auto& [ptid, clear] : world.clearFunctions) clear();
+        for (auto& [group, props] : world.groupProps)
+        {
+            for (auto& [ptid, ids] : props) ids.clear();
+        }
+        world.destroyingGroups.clear();
+        for (auto& [tag, groups] : world.tagStages)
+        {
+            for (auto& [group, instances] : groups) instances.clear();
+        }
+        world.tagsToAdd.clear();
+        world.tagsToRemove.clear();
+        world.stagingGrowth.clear();
+        world.replicaIds.clear();
+        world.ptpsq.clear();
+        world.partialStatics.clear();
+        world.stagingPropTuples.clear();
+        world.novelTuples.clear();
+        world.tupleVersions.clear();
+        world.tableOwners.clear();
+        world.tableSharers.clear();
+        world.placedTables.clear();
+        world.pendingMatches.clear();
+        world.fusionChecks.clear();
+        world.instanceBuffer.clear();
+        world.stageUsers.clear();
+        for (auto& [ptid, subscribers] : world.dirtyProps)
+        {
+            for (auto& [sunid, dirty] : subscribers) dirty.clear();
+        }
+        world.pendingEmerges.clear();
+        world.pendingBreakups.clear();
+        world.propsToAdd.clear();
+        world.creationCursor = 0;
+        world.propsToRemove.clear();
+        world.removalQueue.clear();
+        world.removalCursor = 0;
+        world.unsplitRemovals = 0;
+        world.hiddenProps.clear();
+        // Whatever was still queued is gone, so every outstanding batch has landed
+        world.appliedCreations = world.queuedCreations;
+        world.appliedRemovals = world.queuedRemovals;
+        world.landingCallbacks.clear();
+    }
+
+    // Group arenas ----------------
+    // Every prop staged on a group is indexed by group, so a level loaded into a group can be torn down without evaluating a removal predicate on every prop
+    // The props are removed with the next RemovePropsDelayed and the group's instances are recycled once the returned batch lands
+    // The whole group (and removals queued before it) is removed in one chunk whatever the removal budget, so its tuples are found in one scan of each affected table
+    // Don't stage new props on the group until then
+    static PropBatch DestroyGroup(Group group)
+    {
+        World& world = GetWorld();
+        auto indexed = world.groupProps.find(group);
+        if (indexed != world.groupProps.end())
+        {
+            for (auto& [ptid, props] : indexed->second)
+            {
+                props.forEach([&world, ptid = ptid](size_t pidr){ QueueRemoval(world, ptid, pidr); });
+            }
+        }
+        // Props that were added but not created yet are dropped before they form any novel tuples
+        for (size_t i = world.creationCursor; i < world.propsToAdd.size(); i++)
+        {
+            DelayedPropCreator& creator = world.propsToAdd[i];
+            if (creator.cancelled) continue;
+            for (const Stage& stage : creator.stages)
+            {
+                if (stage.group != group) continue;
+                CancelCreation(world, creator);
+                break;
+            }
+        }
+        world.destroyingGroups.insert(group);
+        world.unsplitRemovals = world.removalQueue.size();
+        PropBatch batch = MarkPropBatch();
+        OnLanded(batch, [&world, group]{
+            world.destroyingGroups.erase(group);
+            // The freed instance list keeps its capacity for the next level
+            world.instanceBuffer[group].reset();
+            std::vector<uint32_t>& users = world.stageUsers[group];
+            std::fill(users.begin(), users.end(), 0);
+            for (auto& [tag, groups] : world.tagStages)
+            {
+                auto instances = groups.find(group);
+                if (instances != groups.end()) instances->second.clear();
+            }
+        });
+        return batch;
     }
 
     static void ResetSunLambdas()
     {
+        World& world = GetWorld();
         // DO NOT CLEAR REGISTRY OR TYPESETS
-        breakups.clear();
-        emerges.clear();
-        schedules.clear();
-        novelTupleCreators.clear();
+        DestroyTasks(world);
+        world.sortOrders.clear();
+        world.breakups.clear();
+        world.emerges.clear();
+        world.batchedJolts.clear();
+        world.dormant.clear();
+        world.pendingMatches.clear();
+        world.schedules.clear();
+        world.novelTupleCreators.clear();
+        world.changeTrackers.clear();
+        world.dirtyProps.clear();
+        // The journal isn't a SunLambda, it keeps watching its prop types
+        for (auto& [ptid, type] : world.journalTypes) world.dirtyProps[ptid][journal_subscriber];
+        world.seenChangeVersions.clear();
     }
 
     static void Reset()
@@ -722,11 +1475,13 @@ public:
     template <typename PropType>
     static void Singleton()
     {
-        for (const Typeset& typeset : mappedPropTupleTypesets[GetPropTypeId<PropType>()])
+        World& world = GetWorld();
+        for (const Typeset& typeset : TypesetsWithPropType(GetPropTypeId<PropType>()))
         {
-            for (SunLambda::Id& sunLambdaId : typesetSunLambdas[typeset])
+            for (const SunLambda::Id& sunLambdaId : SunLambdasWithTypeset(typeset))
             {
-                mango::novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] = 
+                Unshare(world, sunLambdaId);
+                world.novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] = 
                     [](std::set<Stage>&, PropTypeId, std::set<Stage>&){ return true; };
             }
         }
@@ -735,22 +1490,29 @@ public:
     template <typename PropType>
     static void Singleton(SunLambda::Id sunLambdaId)
     {
-        mango::novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] =
+        World& world = GetWorld();
+        Unshare(world, sunLambdaId);
+        world.novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] =
                 [](std::set<Stage>&, PropTypeId, std::set<Stage>&){ return true; };
     }
 
     template <typename PropType>
     static void Partial(SunLambda::Id sunLambdaId, std::function<bool(std::set<Stage>&, PropTypeId, std::set<Stage>&)> reuse)
     {
-        mango::novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] = reuse;
+        World& world = GetWorld();
+        Unshare(world, sunLambdaId);
+        world.novelTupleCreators[sunLambdaId].reuseOnStages[mango::GetPropTypeId<PropType>()] = reuse;
     }
 
     template <typename PropType>
     static void Require(SunLambda::Id sunLambdaId, Group group)
     {
-        novelTupleCreators[sunLambdaId].compatible = [group](PropTypeId ptid, GroupSet& stages) {
+        World& world = GetWorld();
+        Unshare(world, sunLambdaId);
+        // The required type is resolved here so that the constraint doesn't touch world state when Rematch evaluates it on several threads
+        world.novelTupleCreators[sunLambdaId].compatible = [group, required = GetPropTypeId<PropType>()](PropTypeId ptid, GroupSet& stages) {
             // TODO: There should probably be a distinct compatible function per sunlambda proptype so that multiple requirements are supported
-            if (GetPropTypeId<PropTypeId>() == ptid)
+            if (required == ptid)
             {
                 for (const Stage& stage : stages) {
                     if (stage.group == group) return true;
@@ -768,10 +1530,30 @@ public:
     }
 
     template <typename PropType>
-    static SparseArray<PropType>& GetProps()
+    static typename PropStorage<PropType>::type& GetProps()
+    {
+        using Storage = typename PropStorage<PropType>::type;
+        // Finding the world's storage is a hash lookup, so remember the last one found on this thread
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local Storage* cached = nullptr;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            cached = &FindStorage<Storage>(world.propStorage, std::type_index(typeid(PropType)).hash_code());
+            cachedSerial = world.serial;
+        }
+        return *cached;
+    }
+
+    template <typename Storage>
+    static Storage& FindStorage(std::unordered_map<PropTypeId, std::shared_ptr<void>>& storage, PropTypeId ptid)
     {
-        static SparseArray<PropType> props;
-        return props;
+        std::shared_ptr<void>& erased = storage[ptid];
+        if (!erased)
+        {
+            erased = std::make_shared<Storage>();
+        }
+        return *static_cast<Storage*>(erased.get());
     }
 
     template <typename PropType>
@@ -785,22 +1567,2298 @@ public:
         return nullptr;
     }
 
-private:
+    // Rematch ----------------
+    // Props with fewer candidates than this are checked for compatibility on the calling thread alone
+    static constexpr size_t RematchGrain = 4096;
 
-    template <typename ... PTypes, std::size_t ... Is>
-    static auto IterateProps(void (*functor)(PTypes...), const SunLambda::Id& id, std::index_sequence<Is...> seq)
+    /*
+     * Rebuild the novel tuples of a SunLambda from every prop that exists
+     * Use this when a SunLambda is planned or constrained (Require/Partial/Singleton) after props were added, since ConsiderProp only matches props as they're added
+     * Compatible constraints of large prop populations are evaluated on the shared JobPool, so they must not modify anything
+     * No emerge is called for the rebuilt tuples, since most of them were already formed (and emerged) before the rebuild
+     * Tuples the rebuild dissolves (ie a new Require no longer holds for them) break up while their props still exist
+     */
+    static void Rematch(SunLambda::Id id)
     {
-        for (auto& tuple : novelTuples[id])
+        World& world = GetWorld();
+        // Every prop is matched below, so a dormant SunLambda has nothing left pending
+        if (world.dormant.erase(id)) world.pendingMatches.erase(id);
+        // A shared table is rebuilt once for all of its SunLambdas
+        const SunLambda::Id table = TableOf(world, id);
+        if (table != id)
         {
-            functor(GetProps<std::decay_t<PTypes>>()[tuple[Is].id]...);
+            Rematch(table);
+            return;
         }
+        const std::vector<SunLambda::Id> sharers = SharersOf(world, id);
+        const bool breaksUp = std::any_of(sharers.begin(), sharers.end(), [&world](SunLambda::Id sharer){ return world.breakups.count(sharer) > 0; });
+        std::vector<std::vector<GlobalPropId>> before;
+        if (breaksUp) before = world.novelTuples[id];
+        Join(world, id, nullptr);
+        if (!breaksUp) return;
+
+        auto Ids = [](const std::vector<GlobalPropId>& tuple)
+        {
+            std::vector<PropIdRaw> ids;
+            ids.reserve(tuple.size());
+            for (const GlobalPropId& gpid : tuple) ids.push_back(gpid.id);
+            return ids;
+        };
+        std::set<std::vector<PropIdRaw>> rebuilt;
+        for (const auto& tuple : world.novelTuples[id]) rebuilt.insert(Ids(tuple));
+        for (const auto& tuple : before)
+        {
+            if (!rebuilt.count(Ids(tuple))) BreakupTuple(world, id, tuple);
+        }
+        FlushJolts(world.pendingBreakups, false);
     }
 
-public:
+    // Raw ids of props per prop type, ie the pending props of a lazy SunLambda
+    using PropLists = std::unordered_map<PropTypeId, std::vector<PropIdRaw>>;
 
-    template <typename ... PTypes>
-    static auto IterateProps(void (*functor)(PTypes...), const SunLambda::Id& id)
+    // Rebuilds the tuples of a table from the props listed in among, or from every prop without it
+    static void Join(World& world, SunLambda::Id id, const PropLists* among)
     {
-        return IterateProps<PTypes...>(functor, id, std::index_sequence_for<PTypes...> {});
+        static const std::vector<PropIdRaw> none;
+        const Typeset& typeset = TypesetOf(id);
+        world.novelTuples[id].clear();
+        world.tupleVersions[id]++;
+        world.stagingPropTuples[id].clear();
+        world.partialStatics[id].clear();
+        if (typeset.empty()) return;
+        NovelTupleCreator& creator = world.novelTupleCreators[id];
+
+        std::vector<std::vector<PropIdRaw>> candidates(typeset.size());
+        std::vector<size_t> consumed;
+        std::vector<size_t> reused;
+        for (size_t column = 0; column < typeset.size(); column++)
+        {
+            const std::vector<PropIdRaw>* listed = nullptr;
+            if (among)
+            {
+                auto list = among->find(typeset[column]);
+                listed = list != among->end() ? &list->second : &none;
+            }
+            candidates[column] = CompatibleProps(world, creator, typeset[column], listed);
+            (creator.reuseOnStages.count(typeset[column]) ? reused : consumed).push_back(column);
+        }
+        for (size_t column : reused)
+        {
+            world.partialStatics[id][typeset[column]] = candidates[column];
+        }
+
+        // Consumed props are zipped together in raw id order, like ConsiderProp pairing the oldest staged neighbors
+        // A typeset made only of partial statics forms a tuple for each prop of its first type
+        const size_t anchorColumn = consumed.empty() ? 0 : consumed[0];
+        size_t rows = candidates[anchorColumn].size();
+        for (size_t column : consumed) rows = std::min(rows, candidates[column].size());
+
+        auto& tuples = world.novelTuples[id];
+        auto& staging = world.stagingPropTuples[id];
+        const PropTypeId anchorType = typeset[anchorColumn];
+        for (size_t row = 0; row < rows; row++)
+        {
+            std::vector<GlobalPropId> tuple(typeset.size());
+            const PropIdRaw anchor = candidates[anchorColumn][row];
+            GroupSet& anchorStages = world.ptpsq[anchorType][anchor];
+            bool formed = true;
+            for (size_t column : consumed)
+            {
+                tuple[column] = {typeset[column], candidates[column][row]};
+            }
+            for (size_t column : reused)
+            {
+                if (column == anchorColumn)
+                {
+                    tuple[column] = {anchorType, anchor};
+                    continue;
+                }
+                const PropTypeId ptid = typeset[column];
+                auto& reuse = creator.reuseOnStages[ptid];
+                auto& stages = world.ptpsq[ptid];
+                auto found = std::find_if(candidates[column].begin(), candidates[column].end(), [&](PropIdRaw ps)
+                {
+                    return reuse(anchorStages, anchorType, stages[ps]);
+                });
+                if (found == candidates[column].end())
+                {
+                    formed = false;
+                    break;
+                }
+                tuple[column] = {ptid, *found};
+            }
+
+            if (formed)
+            {
+                tuples.push_back(std::move(tuple));
+            }
+            else
+            {
+                for (size_t column : consumed) staging[typeset[column]].push_back(candidates[column][row]);
+            }
+        }
+        // Leftovers wait for neighbors in staging just like props added one at a time
+        for (size_t column : consumed)
+        {
+            for (size_t row = rows; row < candidates[column].size(); row++) staging[typeset[column]].push_back(candidates[column][row]);
+        }
+
+        Count(world.matchCounters.matched, tuples.size());
+        Count(world.matchCounters.staged, CountProps(staging));
+        NotePeak(world.novelTuplePeaks[id], tuples.size());
+        NotePeak(world.stagingPeaks[id], CountProps(staging));
+        NotePeak(world.partialStaticPeaks[id], CountProps(world.partialStatics[id]));
+        for (SunLambda::Id sharer : SharersOf(world, id))
+        {
+            if (world.changeTrackers.count(sharer)) TrackChanges(sharer);
+        }
+        Resort(id);
+    }
+
+    // Every prop of a type (or of among) that fulfills the compatible constraint, sorted by raw id
+    static std::vector<PropIdRaw> CompatibleProps(World& world, NovelTupleCreator& creator, PropTypeId ptid, const std::vector<PropIdRaw>* among = nullptr)
+    {
+        std::vector<PropIdRaw> ids;
+        auto props = world.ptpsq.find(ptid);
+        if (props == world.ptpsq.end()) return ids;
+        // Props waiting for a carried over removal are left out like ConsiderProp leaves them out
+        if (among)
+        {
+            ids.reserve(among->size());
+            for (PropIdRaw pidr : *among)
+            {
+                if (props->second.count(pidr) && !IsHidden(world, ptid, pidr)) ids.push_back(pidr);
+            }
+        }
+        else
+        {
+            ids.reserve(props->second.size());
+            for (auto& [pidr, stages] : props->second)
+            {
+                if (!IsHidden(world, ptid, pidr)) ids.push_back(pidr);
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        if (!creator.compatible) return ids;
+
+        std::vector<char> compatible(ids.size());
+        auto Check = [&](size_t begin, size_t end)
+        {
+            WorldScope scope(world);
+            for (size_t i = begin; i < end; i++)
+            {
+                compatible[i] = creator.compatible(ptid, props->second.find(ids[i])->second);
+            }
+        };
+        // The calling thread checks the first chunk while the shared pool checks the rest
+        // Its own group is waited on rather than the world's jobs, which may include long running task jobs
+        const size_t workers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), ids.size() / RematchGrain));
+        const size_t chunk = (ids.size() + workers - 1) / workers;
+        JobGroup checks;
+        for (size_t w = 1; w < workers; w++)
+        {
+            checks.push(JobPool::shared(), [&Check, w, chunk, &ids]{ Check(w * chunk, std::min(ids.size(), (w + 1) * chunk)); });
+        }
+        Check(0, std::min(ids.size(), chunk));
+        checks.wait();
+
+        size_t kept = 0;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            if (compatible[i]) ids[kept++] = ids[i];
+        }
+        Count(world.matchCounters.constraintFailures, ids.size() - kept);
+        ids.resize(kept);
+        return ids;
+    }
+
+    // Memory ----------------
+    // Reserve storage for n props of a type before a big spawn wave
+    template <typename PropType>
+    static void Reserve(size_t n)
+    {
+        World& world = GetWorld();
+        GetProps<PropType>().reserve(n);
+        world.ptpsq[GetPropTypeId<PropType>()].reserve(n);
+    }
+
+    // Reserve a SunLambda's tuple table for n novel tuples
+    static void ReserveTuples(SunLambda::Id id, size_t n)
+    {
+        World& world = GetWorld();
+        TuplesOf(world, id).reserve(n);
+    }
+
+    // Byte counts of node based containers are estimates, we can't see the allocator's overhead
+    struct MemoryStats
+    {
+        size_t live = 0;
+        size_t capacity = 0;
+        size_t bytes = 0;
+        size_t peak = 0;
+    };
+
+    struct MemoryReport
+    {
+        std::unordered_map<PropTypeId, MemoryStats> props;
+        MemoryStats propStages; // ptpsq
+        std::unordered_map<SunLambda::Id, MemoryStats> novelTuples;
+        std::unordered_map<SunLambda::Id, MemoryStats> stagingPropTuples;
+        std::unordered_map<SunLambda::Id, MemoryStats> partialStatics;
+    };
+
+    static void NotePeak(size_t& peak, size_t live)
+    {
+        peak = std::max(peak, live);
+    }
+
+    static size_t CountProps(const std::unordered_map<PropTypeId, std::vector<PropIdRaw>>& props)
+    {
+        size_t count = 0;
+        for (auto& [ptid, ids] : props) count += ids.size();
+        return count;
+    }
+
+    static size_t CountPropStages()
+    {
+        World& world = GetWorld();
+        size_t count = 0;
+        for (auto& [ptid, props] : world.ptpsq) count += props.size();
+        return count;
+    }
+
+    static MemoryStats MeasurePropLists(const std::unordered_map<PropTypeId, std::vector<PropIdRaw>>& props, size_t peak)
+    {
+        MemoryStats stats{CountProps(props), 0, props.bucket_count() * sizeof(void*), peak};
+        for (auto& [ptid, ids] : props)
+        {
+            stats.capacity += ids.capacity();
+            stats.bytes += sizeof(std::pair<PropTypeId, std::vector<PropIdRaw>>) + 2 * sizeof(void*) + ids.capacity() * sizeof(PropIdRaw);
+        }
+        return stats;
+    }
+
+    static MemoryReport GetMemoryReport()
+    {
+        World& world = GetWorld();
+        MemoryReport report;
+        for (auto& [ptid, Measure] : world.memoryFunctions)
+        {
+            report.props[ptid] = Measure();
+        }
+
+        report.propStages = {CountPropStages(), 0, world.ptpsq.bucket_count() * sizeof(void*), world.propStagesPeak};
+        for (auto& [ptid, props] : world.ptpsq)
+        {
+            report.propStages.capacity += props.bucket_count();
+            report.propStages.bytes += props.bucket_count() * sizeof(void*);
+            for (auto& [pidr, stages] : props)
+            {
+                report.propStages.bytes += sizeof(std::pair<PropIdRaw, std::set<Stage>>) + 2 * sizeof(void*) + stages.size() * (sizeof(Stage) + 4 * sizeof(void*));
+            }
+        }
+
+        for (auto& [sunid, tuples] : world.novelTuples)
+        {
+            MemoryStats& stats = report.novelTuples[sunid];
+            stats = {tuples.size(), tuples.capacity(), tuples.capacity() * sizeof(std::vector<GlobalPropId>), world.novelTuplePeaks[sunid]};
+            for (auto& tuple : tuples) stats.bytes += tuple.capacity() * sizeof(GlobalPropId);
+        }
+        for (auto& [sunid, staged] : world.stagingPropTuples)
+        {
+            report.stagingPropTuples[sunid] = MeasurePropLists(staged, world.stagingPeaks[sunid]);
+        }
+        for (auto& [sunid, statics] : world.partialStatics)
+        {
+            report.partialStatics[sunid] = MeasurePropLists(statics, world.partialStaticPeaks[sunid]);
+        }
+        return report;
+    }
+
+    static void PrintMemoryReport()
+    {
+        World& world = GetWorld();
+        auto Print = [](const std::string& name, const MemoryStats& stats)
+        {
+            std::cout << name << ": " << stats.live << " live, " << stats.capacity << " capacity, " << stats.bytes << " bytes, " << stats.peak << " peak" << std::endl;
+        };
+        MemoryReport report = GetMemoryReport();
+        for (auto& [ptid, stats] : report.props) Print(world.propTypeNames[ptid], stats);
+        Print("Prop stages", report.propStages);
+        auto& registry = SunLambdaRegistry::GetInstance();
+        for (auto& [sunid, stats] : report.novelTuples) Print(std::string("Novel tuples of ") + registry.Get(sunid).name, stats);
+        for (auto& [sunid, stats] : report.stagingPropTuples) Print(std::string("Staged props of ") + registry.Get(sunid).name, stats);
+        for (auto& [sunid, stats] : report.partialStatics) Print(std::string("Partial statics of ") + registry.Get(sunid).name, stats);
+    }
+
+    // Match statistics ----------------
+    // Counted as the matching engine runs, relaxed atomics because Rematch evaluates constraints on several threads
+    struct MatchCounters
+    {
+        std::atomic<uint64_t> searches{0};
+        std::atomic<uint64_t> constraintFailures{0};
+        std::atomic<uint64_t> staged{0};
+        std::atomic<uint64_t> matched{0};
+        std::atomic<uint64_t> restaged{0};
+    };
+
+    struct MatchStats
+    {
+        // Novel tuple searches run when a prop is considered for a SunLambda
+        uint64_t searches = 0;
+        // Props rejected by the compatible constraint of a SunLambda
+        uint64_t constraintFailures = 0;
+        // Props staged to wait for neighbors
+        uint64_t staged = 0;
+        // Novel tuples formed
+        uint64_t matched = 0;
+        // Props restaged after their novel tuple was broken by a removal
+        uint64_t restaged = 0;
+    };
+
+    // Taken at the end of every loop
+    struct FrameMatchStats
+    {
+        uint64_t frame = 0;
+        MatchStats frameCounts;
+        MatchStats totals;
+        // Staged props of each SunLambda
+        std::unordered_map<SunLambda::Id, size_t> staging;
+        // SunLambdas whose staged props keep piling up without ever forming novel tuples, usually a missing neighbor type or a constraint that never passes
+        std::vector<SunLambda::Id> unboundedStaging;
+    };
+
+    // Staging is flagged as unbounded when it grew by StagingWarnSize props over StagingGrowthFrames frames without shrinking once
+    static constexpr size_t StagingWarnSize = 1024;
+    static constexpr uint64_t StagingGrowthFrames = 300;
+
+    struct StagingGrowth
+    {
+        size_t floor = 0;
+        uint64_t since = 0;
+        bool flagged = false;
+    };
+
+    static void Count(std::atomic<uint64_t>& counter, uint64_t n = 1)
+    {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    static MatchStats GetMatchTotals()
+    {
+        const MatchCounters& counters = GetWorld().matchCounters;
+        return {counters.searches.load(std::memory_order_relaxed), counters.constraintFailures.load(std::memory_order_relaxed),
+                counters.staged.load(std::memory_order_relaxed), counters.matched.load(std::memory_order_relaxed),
+                counters.restaged.load(std::memory_order_relaxed)};
+    }
+
+    static const FrameMatchStats& GetMatchStats()
+    {
+        return GetWorld().matchStats;
+    }
+
+    static void SnapshotMatchStats(World& world)
+    {
+        FrameMatchStats& stats = world.matchStats;
+        const MatchStats totals = GetMatchTotals();
+        stats.frame = world.frame;
+        stats.frameCounts = {totals.searches - stats.totals.searches, totals.constraintFailures - stats.totals.constraintFailures,
+                             totals.staged - stats.totals.staged, totals.matched - stats.totals.matched,
+                             totals.restaged - stats.totals.restaged};
+        stats.totals = totals;
+        stats.unboundedStaging.clear();
+        for (auto& [sunid, staged] : world.stagingPropTuples)
+        {
+            const size_t size = CountProps(staged);
+            StagingGrowth& growth = world.stagingGrowth[sunid];
+            if (size < stats.staging[sunid] || size < growth.floor)
+            {
+                growth = {size, world.frame, false};
+            }
+            stats.staging[sunid] = size;
+            if (size - growth.floor >= StagingWarnSize && world.frame - growth.since >= StagingGrowthFrames)
+            {
+                stats.unboundedStaging.push_back(sunid);
+                if (!growth.flagged)
+                {
+                    std::cout << "WARNING: " << size << " props are staged on " << SunLambdaRegistry::GetInstance().Get(sunid).name << " and it hasn't shrunk in " << world.frame - growth.since << " frames" << std::endl;
+                    growth.flagged = true;
+                }
+            }
+        }
+    }
+
+    static void PrintMatchStats()
+    {
+        const FrameMatchStats& stats = GetMatchStats();
+        const MatchStats& counts = stats.frameCounts;
+        std::cout << "Frame " << stats.frame << ": " << counts.searches << " searches, " << counts.constraintFailures << " constraint failures, "
+                  << counts.staged << " staged, " << counts.matched << " matched, " << counts.restaged << " restaged" << std::endl;
+        for (SunLambda::Id sunid : stats.unboundedStaging)
+        {
+            std::cout << "Unbounded staging on " << SunLambdaRegistry::GetInstance().Get(sunid).name << ": " << stats.staging.at(sunid) << " props" << std::endl;
+        }
+    }
+
+    // Live stats ----------------
+    /*
+     * While the stats segment is open, Loop publishes the frame time, the time each SunLambda acted for, live props per type and staged props per SunLambda into shared memory
+     * Publishing is a seqlocked copy into the segment, readers retry when the frame changes under them so the game thread never waits on them (see tools/mango_stats.cpp)
+     */
+    static bool OpenStats(const std::string& name = "/bicycle_mango")
+    {
+        World& world = GetWorld();
+        world.stats.Close();
+        world.stats = StatsSegment::Create(name);
+        if (!world.stats.IsValid())
+        {
+            std::cout << "Could not open the stats segment " << name << std::endl;
+        }
+        return world.stats.IsValid();
+    }
+
+    static void CloseStats()
+    {
+        World& world = GetWorld();
+        world.stats.Close();
+        world.actTimes.clear();
+    }
+
+    // SunLambdas are only timed while the stats segment is open
+    static void Timed(SunLambda::Id id, const SunLambda& lambda)
+    {
+        World& world = GetWorld();
+        if (!world.stats.IsValid())
+        {
+            lambda();
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        lambda();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        // The presentation thread keeps its own timings so the two threads never write to the same map
+        (presenting ? world.presentationTimes : world.actTimes)[id] += elapsed.count();
+    }
+
+    static void PublishStats(World& world)
+    {
+        auto& registry = SunLambdaRegistry::GetInstance();
+        StatsSegment::Layout& layout = world.stats.BeginWrite();
+        layout.frame = world.matchStats.frame;
+        layout.frameMicroseconds = delta.asMicroseconds();
+        layout.searches = world.matchStats.frameCounts.searches;
+        layout.staged = world.matchStats.frameCounts.staged;
+        layout.matched = world.matchStats.frameCounts.matched;
+
+        uint32_t count = 0;
+        for (const SunSchedule& schedule : world.schedules)
+        {
+            if (count == StatsSegment::MaxEntries) break;
+            auto& times = world.pipelined && IsPresentation(schedule) ? world.presentedTimes : world.actTimes;
+            auto time = times.find(schedule.id);
+            layout.lambdas.entries[count++].set(schedule.id, time != times.end() ? time->second : 0, [&]() -> std::string_view { return registry.Get(schedule.id).name; });
+        }
+        layout.lambdas.count = count;
+
+        count = 0;
+        for (auto& [ptid, props] : world.ptpsq)
+        {
+            if (count == StatsSegment::MaxEntries) break;
+            layout.props.entries[count++].set(ptid, props.size(), [&]() -> std::string_view { return world.propTypeNames[ptid]; });
+        }
+        layout.props.count = count;
+
+        count = 0;
+        for (auto& [sunid, size] : world.matchStats.staging)
+        {
+            if (count == StatsSegment::MaxEntries) break;
+            layout.staging.entries[count++].set(sunid, size, [&, id = sunid]() -> std::string_view { return registry.Get(id).name; });
+        }
+        layout.staging.count = count;
+        world.stats.EndWrite();
+
+        // Timings are per frame
+        for (auto& [sunid, time] : world.actTimes) time = 0;
+    }
+
+    // Pipelined frames ----------------
+    // When pipelined, the presentation stages (ANIMATION onwards) of frame N run on a second thread while the simulation stages of frame N+1 run on the calling thread
+    // Presentation SunLambdas see a snapshot of their novel tuples and props taken at the end of frame N, so writes they make to props are discarded at the next snapshot
+    static bool IsPresentation(const SunSchedule& schedule)
+    {
+        return schedule.specificity.specificity[0] >= ANIMATION;
+    }
+
+    // Is the calling thread the presentation thread?
+    static inline thread_local bool presenting = false;
+
+    struct Presentation
+    {
+        SunSchedule schedule;
+        SunLambda lambda;
+    };
+
+    template <typename PropType>
+    static typename PropStorage<PropType>::type& GetPropsSnapshot()
+    {
+        using Storage = typename PropStorage<PropType>::type;
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local Storage* cached = nullptr;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            cached = &FindStorage<Storage>(world.snapshotStorage, std::type_index(typeid(PropType)).hash_code());
+            cachedSerial = world.serial;
+        }
+        return *cached;
+    }
+
+    static void WaitForPresentation()
+    {
+        World& world = GetWorld();
+        std::unique_lock<std::mutex> lock(world.presenterMutex);
+        world.presenterSignal.wait(lock, [&world]{ return !world.presentationPending; });
+    }
+
+    static void PresentPipelined()
+    {
+        World& world = GetWorld();
+        // Presentation of the previous frame must be done before its snapshot is overwritten
+        WaitForPresentation();
+        // The previous frame's presentation timings are published with this frame's stats
+        world.presentedTimes.swap(world.presentationTimes);
+        world.presentationTimes.clear();
+
+        std::set<PropTypeId> snapshotTypes;
+        std::set<PropTypeId> resourceTypes;
+        world.presentations.clear();
+        for (const SunSchedule& schedule : world.schedules)
+        {
+            if (!IsPresentation(schedule)) continue;
+            world.presentations.push_back({schedule, SunLambdaRegistry::GetInstance().Get(schedule.id)});
+            auto& snapshot = world.presentationTuples[schedule.id];
+            KeepSorted(world, schedule.id);
+            snapshot = TuplesOf(world, schedule.id);
+            // Props still waiting for a budgeted removal stay hidden from presentation too
+            // Tags are tested here too since the presentation thread can't read stages
+            const bool tagged = !TagsOf(schedule.id).empty();
+            snapshot.erase(std::remove_if(snapshot.begin(), snapshot.end(), [&world, &schedule, tagged](const std::vector<GlobalPropId>& tuple)
+            {
+                for (const GlobalPropId& gpid : tuple)
+                {
+                    if (IsHidden(world, gpid.typeId, gpid.id)) return true;
+                }
+                return tagged && !HasTags(world, schedule.id, tuple);
+            }), snapshot.end());
+            for (PropTypeId ptid : TypesetOf(schedule.id)) snapshotTypes.insert(ptid);
+            auto resources = sunLambdaResources.find(schedule.id);
+            if (resources != sunLambdaResources.end()) resourceTypes.insert(resources->second.begin(), resources->second.end());
+        }
+        for (PropTypeId ptid : snapshotTypes)
+        {
+            world.snapshotFunctions[ptid]();
+        }
+        for (PropTypeId ptid : resourceTypes)
+        {
+            resourceSnapshotFunctions[ptid]();
+        }
+        for (auto& [type, snapshot] : world.eventSnapshotFunctions)
+        {
+            snapshot();
+        }
+        world.presentationFrame = world.frame;
+        world.presentationDelta = delta;
+
+        if (!world.presenter.joinable())
+        {
+            world.presenter = std::thread(Present, &world);
+        }
+        {
+            std::lock_guard<std::mutex> lock(world.presenterMutex);
+            world.presentationPending = true;
+        }
+        world.presenterSignal.notify_all();
+    }
+
+    static void Present(World* owner)
+    {
+        current = owner;
+        presenting = true;
+        World& world = *owner;
+        std::unique_lock<std::mutex> lock(world.presenterMutex);
+        while (true)
+        {
+            world.presenterSignal.wait(lock, [&world]{ return world.presentationPending || world.stopPresenting; });
+            if (world.stopPresenting) return;
+            lock.unlock();
+            delta = world.presentationDelta;
+            for (const Presentation& presentation : world.presentations)
+            {
+                Act(presentation.schedule, presentation.lambda, world.presentationFrame);
+            }
+            lock.lock();
+            world.presentationPending = false;
+            world.presenterSignal.notify_all();
+        }
+    }
+
+    // Finish the last presented frame and join the presentation thread, this must be called before exiting a pipelined game
+    static void StopPipeline()
+    {
+        World& world = GetWorld();
+        if (!world.presenter.joinable()) return;
+        WaitForPresentation();
+        {
+            std::lock_guard<std::mutex> lock(world.presenterMutex);
+            world.stopPresenting = true;
+        }
+        world.presenterSignal.notify_all();
+        world.presenter.join();
+        world.stopPresenting = false;
+    }
+
+    // Change tracking ----------------
+    // For each prop type, one bit per PropIdRaw that changed since each change tracking SunLambda last ran
+    using DirtySubscribers = std::unordered_map<SunLambda::Id, DynamicBitset>;
+
+    // Props passed to a SunLambda by non-const reference are assumed to be written to
+    template <typename PropType>
+    static constexpr bool IsWrittenProp = std::is_lvalue_reference_v<PropType> && !std::is_const_v<std::remove_reference_t<PropType>>;
+
+    static void TrackChanges(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        world.changeTrackers.insert(id);
+        world.seenChangeVersions.erase(id);
+        // Props that already exist have never been seen by this SunLambda, so they all start dirty
+        for (PropTypeId ptid : TypesetOf(id))
+        {
+            DynamicBitset& dirty = world.dirtyProps[ptid][id];
+            auto props = world.ptpsq.find(ptid);
+            if (props == world.ptpsq.end()) continue;
+            for (auto& [pidr, stages] : props->second) dirty.set(pidr);
+        }
+    }
+
+    static void UntrackChanges(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        world.changeTrackers.erase(id);
+        world.seenChangeVersions.erase(id);
+        for (PropTypeId ptid : TypesetOf(id))
+        {
+            world.dirtyProps[ptid].erase(id);
+        }
+    }
+
+    // Mark a prop as changed for every change tracking SunLambda except the one writing to it
+    static void MarkDirty(PropTypeId ptid, PropIdRaw pidr, SunLambda::Id writer = sun_lambda_none)
+    {
+        World& world = GetWorld();
+        world.changeVersions[ptid]++;
+        auto subscribers = world.dirtyProps.find(ptid);
+        if (subscribers == world.dirtyProps.end()) return;
+        for (auto& [sunid, dirty] : subscribers->second)
+        {
+            if (sunid != writer) dirty.set(pidr);
+        }
+    }
+
+    template <typename PropType>
+    static void MarkDirty(PropId<PropType> propId)
+    {
+        MarkDirty(GetPropTypeId<PropType>(), propId.id);
+    }
+
+    template <typename PropType>
+    static void MarkDirty(PropType* prop)
+    {
+        MarkDirty(GetPropTypeId<PropType>(), GetPropId<PropType>(prop));
+    }
+
+    static bool HasChanges(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        auto seen = world.seenChangeVersions.find(id);
+        if (seen == world.seenChangeVersions.end()) return true;
+        for (PropTypeId ptid : TypesetOf(id))
+        {
+            if (world.changeVersions[ptid] != seen->second[ptid]) return true;
+        }
+        return false;
+    }
+
+    // Resources ----------------
+    /*
+     * A resource is a prop type marked with ResourceProp, each world has exactly one of it and it is created the first time it is asked for
+     * Resources are left out of typesets like tags, IterateProps and jolts look one up once and pass it along with every tuple
+     * This replaces Singleton, which still stores the prop in every novel tuple
+     * A SunLambda that takes nothing but resources acts once per schedule
+     * ResetProps leaves resources as they are
+     */
+    template <typename ResourceType>
+    static ResourceType& GetResource()
+    {
+        static_assert(IsResource<ResourceType>, "Mark the type with ResourceProp");
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local ResourceType* cached = nullptr;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            cached = &FindStorage<ResourceType>(world.resourceStorage, std::type_index(typeid(ResourceType)).hash_code());
+            cachedSerial = world.serial;
+        }
+        return *cached;
+    }
+
+    // The copy of a resource read by presentation SunLambdas
+    template <typename ResourceType>
+    static ResourceType& GetResourceSnapshot()
+    {
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local ResourceType* cached = nullptr;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            cached = &FindStorage<ResourceType>(world.resourceSnapshotStorage, std::type_index(typeid(ResourceType)).hash_code());
+            cachedSerial = world.serial;
+        }
+        return *cached;
+    }
+
+    static inline std::unordered_map<PropTypeId, std::function<void()>> resourceSnapshotFunctions;
+
+    template <typename PropType>
+    static void RegisterResource()
+    {
+        if constexpr (IsResource<PropType>)
+        {
+            using ResourceType = std::decay_t<PropType>;
+            resourceSnapshotFunctions[GetPropTypeId<ResourceType>()] = []{ GetResourceSnapshot<ResourceType>() = GetResource<ResourceType>(); };
+        }
+    }
+
+    // Tags ----------------
+    /*
+     * Empty prop types (Dead, Selected, OnFire...) are tags, they get no storage of their own and are kept as one bit per stage
+     * Adding a tag sets the bit of each of its stages, RemoveProps clears the bits of the stages it matches and a tag goes away with its instance
+     * Tags are left out of typesets, so they never take part in novel tuple searches
+     * A novel tuple of a SunLambda with tags is only acted while a stage of its first prop has every tag
+     * Jolts fire on the novel tuples alone, adding or removing a tag doesn't emerge or break up anything
+     */
+    static void SetTag(World& world, PropTypeId tag, const Stage& stage, bool on)
+    {
+        if (on)
+        {
+            world.tagStages[tag][stage.group].set(stage.instance);
+            return;
+        }
+        auto groups = world.tagStages.find(tag);
+        if (groups == world.tagStages.end()) return;
+        auto instances = groups->second.find(stage.group);
+        if (instances != groups->second.end()) instances->second.reset(stage.instance);
+    }
+
+    static bool HasTag(World& world, PropTypeId tag, const GroupSet& stages)
+    {
+        auto groups = world.tagStages.find(tag);
+        if (groups == world.tagStages.end()) return false;
+        for (const Stage& stage : stages)
+        {
+            auto instances = groups->second.find(stage.group);
+            if (instances != groups->second.end() && instances->second.test(stage.instance)) return true;
+        }
+        return false;
+    }
+
+    template <typename Tag>
+    static bool HasTag(const Stage& stage)
+    {
+        static_assert(IsTag<Tag>, "Only empty prop types are tags");
+        return HasTag(GetWorld(), GetPropTypeId<Tag>(), {stage});
+    }
+
+    static bool HasTags(World& world, SunLambda::Id id, const std::vector<GlobalPropId>& tuple)
+    {
+        // A SunLambda needs at least one prop that isn't a tag
+        if (tuple.empty()) return false;
+        auto props = world.ptpsq.find(tuple[0].typeId);
+        if (props == world.ptpsq.end()) return false;
+        auto stages = props->second.find(tuple[0].id);
+        if (stages == props->second.end()) return false;
+        for (PropTypeId tag : TagsOf(id))
+        {
+            if (!HasTag(world, tag, stages->second)) return false;
+        }
+        return true;
+    }
+
+    // Shared tuple tables ----------------
+    /*
+     * Unconstrained SunLambdas of the same typeset match exactly the same novel tuples, so they share one tuple table and one staging pool
+     * The first of them to see a prop owns the table and is the only one ConsiderProp searches for
+     * Equivalent constraints can't be told apart (they're std::functions), so constrained or sorted SunLambdas always match on their own
+     * Constraining or sorting a SunLambda that shares a table gives it a copy of the table first
+     */
+    static bool IsShareable(World& world, SunLambda::Id id)
+    {
+        if (world.sortOrders.count(id)) return false;
+        auto creator = world.novelTupleCreators.find(id);
+        return creator == world.novelTupleCreators.end() || (!creator->second.compatible && creator->second.reuseOnStages.empty());
+    }
+
+    static SunLambda::Id TableOf(World& world, SunLambda::Id id)
+    {
+        auto owner = world.tableOwners.find(id);
+        return owner != world.tableOwners.end() ? owner->second : id;
+    }
+
+    static std::vector<std::vector<GlobalPropId>>& TuplesOf(World& world, SunLambda::Id id)
+    {
+        return world.novelTuples[TableOf(world, id)];
+    }
+
+    // The owner of a table followed by every SunLambda sharing it
+    static std::vector<SunLambda::Id> SharersOf(World& world, SunLambda::Id owner)
+    {
+        std::vector<SunLambda::Id> sharers = {owner};
+        auto shared = world.tableSharers.find(owner);
+        if (shared != world.tableSharers.end()) sharers.insert(sharers.end(), shared->second.begin(), shared->second.end());
+        return sharers;
+    }
+
+    // Decided once per world, when the SunLambda is first searched for
+    static SunLambda::Id PlaceTable(World& world, SunLambda::Id id, const Typeset& typeset)
+    {
+        if (!world.placedTables.insert(id).second) return TableOf(world, id);
+        if (!IsShareable(world, id) || !world.novelTuples[id].empty() || !world.stagingPropTuples[id].empty()) return id;
+        for (SunLambda::Id other : SunLambdasWithTypeset(typeset))
+        {
+            if (other != id && world.placedTables.count(other) && TableOf(world, other) == other && IsShareable(world, other))
+            {
+                world.tableOwners[id] = other;
+                world.tableSharers[other].push_back(id);
+                return other;
+            }
+        }
+        return id;
+    }
+
+    static void CopyTable(World& world, SunLambda::Id from, SunLambda::Id to)
+    {
+        world.novelTuples[to] = world.novelTuples[from];
+        world.stagingPropTuples[to] = world.stagingPropTuples[from];
+        world.partialStatics[to] = world.partialStatics[from];
+        world.tupleVersions[to]++;
+    }
+
+    static void Unshare(World& world, SunLambda::Id id)
+    {
+        world.placedTables.insert(id);
+        auto owner = world.tableOwners.find(id);
+        if (owner != world.tableOwners.end())
+        {
+            const SunLambda::Id table = owner->second;
+            CopyTable(world, table, id);
+            auto& sharers = world.tableSharers[table];
+            sharers.erase(std::find(sharers.begin(), sharers.end(), id));
+            world.tableOwners.erase(owner);
+            return;
+        }
+        auto shared = world.tableSharers.find(id);
+        if (shared == world.tableSharers.end()) return;
+        std::vector<SunLambda::Id> sharers = std::move(shared->second);
+        world.tableSharers.erase(shared);
+        if (sharers.empty()) return;
+        // The first sharer takes over the table and the rest follow it
+        const SunLambda::Id heir = sharers.front();
+        CopyTable(world, id, heir);
+        world.tableOwners.erase(heir);
+        sharers.erase(sharers.begin());
+        for (SunLambda::Id sharer : sharers) world.tableOwners[sharer] = heir;
+        if (!sharers.empty()) world.tableSharers[heir] = std::move(sharers);
+    }
+
+    // Lazy matching ----------------
+    /*
+     * A lazy SunLambda doesn't match props while it's dormant, it only appends them to a pending list
+     * It wakes up the first time it's planned, given an emerge or breakup jolt or iterated, and its tuples are formed then
+     * Spawning props then only costs matching for the SunLambdas in use rather than every one that was declared
+     */
+    static void Lazy(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        // A SunLambda that is already matching props stays eager
+        if (world.placedTables.count(id) || world.emerges.count(id) || world.breakups.count(id)) return;
+        for (const SunSchedule& schedule : world.schedules)
+        {
+            if (schedule.id == id) return;
+        }
+        world.dormant.insert(id);
+    }
+
+    static void Wake(World& world, SunLambda::Id id)
+    {
+        if (!world.dormant.erase(id)) return;
+        auto found = world.pendingMatches.find(id);
+        if (found == world.pendingMatches.end()) return;
+        const PropLists pending = std::move(found->second);
+        world.pendingMatches.erase(found);
+        if (CountProps(pending) == 0) return;
+        // An awake SunLambda of the same typeset already holds every tuple this one would form
+        if (PlaceTable(world, id, TypesetOf(id)) != id) return;
+        // A dormant SunLambda never matched anything, so only its pending props are joined and the rest of the props aren't looked at
+        Join(world, id, &pending);
+    }
+
+    // Sorting ----------------
+    /*
+     * SortBy keeps the novel tuples of a SunLambda in the order of a key read from one of its props, ie depth or layer for rendering
+     * New tuples are appended and merged into place once before the SunLambda next iterates, breakups keep the order, so only new tuples and tuples whose key prop was written get sorted again
+     * Writes through SunLambdas are noticed the same way change tracking notices them, call Resort after moving keys any other way
+     * Sorted SunLambdas are never fused
+     */
+    struct SortOrder
+    {
+        size_t column;
+        PropTypeId ptid;
+        std::function<double(PropIdRaw)> key;
+        // The tuples at the back of the table that were appended since the order was last kept
+        size_t unsorted = 0;
+
+        bool operator()(const std::vector<GlobalPropId>& a, const std::vector<GlobalPropId>& b) const
+        {
+            return key(a[column].id) < key(b[column].id);
+        }
+    };
+
+    // A sort order subscribes to written props apart from its SunLambda, which may track changes itself
+    static SunLambda::Id SortSubscriber(SunLambda::Id id)
+    {
+        return ~id;
+    }
+
+    template <typename PropType, typename Key>
+    static void SortBy(SunLambda::Id id, Key key)
+    {
+        World& world = GetWorld();
+        const PropTypeId ptid = GetPropTypeId<PropType>();
+        const Typeset& typeset = TypesetOf(id);
+        auto column = std::find(typeset.begin(), typeset.end(), ptid);
+        if (column == typeset.end())
+        {
+            std::cout << "Can't sort " << SunLambdaRegistry::GetInstance().Get(id).name << " by a prop it doesn't take" << std::endl;
+            return;
+        }
+        Unshare(world, id);
+        world.sortOrders[id] = {static_cast<size_t>(column - typeset.begin()), ptid, [key](PropIdRaw pidr)
+        {
+            return static_cast<double>(key(GetProps<PropType>()[pidr]));
+        }};
+        world.dirtyProps[ptid][SortSubscriber(id)];
+        Resort(id);
+    }
+
+    static void Unsort(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        auto order = world.sortOrders.find(id);
+        if (order == world.sortOrders.end()) return;
+        world.dirtyProps[order->second.ptid].erase(SortSubscriber(id));
+        world.sortOrders.erase(order);
+    }
+
+    static void Resort(SunLambda::Id id)
+    {
+        World& world = GetWorld();
+        auto order = world.sortOrders.find(id);
+        if (order == world.sortOrders.end()) return;
+        auto& tuples = world.novelTuples[id];
+        std::stable_sort(tuples.begin(), tuples.end(), order->second);
+        order->second.unsorted = 0;
+        world.dirtyProps[order->second.ptid][SortSubscriber(id)].clear();
+        world.tupleVersions[id]++;
+    }
+
+    // Inserting each tuple in order would move the ones after it every time, so new tuples wait at the back for KeepSorted
+    static void InsertTuple(World& world, SunLambda::Id id, const std::vector<GlobalPropId>& tuple)
+    {
+        world.novelTuples[id].push_back(tuple);
+        auto order = world.sortOrders.find(id);
+        if (order != world.sortOrders.end()) order->second.unsorted++;
+    }
+
+    // The tuples with a written key join the new tuples at the back, which are sorted and merged with the rest which are still in order
+    static void KeepSorted(World& world, SunLambda::Id id)
+    {
+        auto order = world.sortOrders.find(id);
+        if (order == world.sortOrders.end()) return;
+        SortOrder& sort = order->second;
+        DynamicBitset& dirty = world.dirtyProps[sort.ptid][SortSubscriber(id)];
+        auto& tuples = world.novelTuples[id];
+        const size_t unsorted = std::min(sort.unsorted, tuples.size());
+        const bool rekeyed = dirty.any();
+        if (!rekeyed && unsorted == 0) return;
+        const auto appended = tuples.end() - unsorted;
+        auto moved = !rekeyed ? appended : std::stable_partition(tuples.begin(), appended, [&](const std::vector<GlobalPropId>& tuple)
+        {
+            return !dirty.test(tuple[sort.column].id);
+        });
+        std::stable_sort(moved, tuples.end(), sort);
+        std::inplace_merge(tuples.begin(), moved, tuples.end(), sort);
+        dirty.clear();
+        sort.unsorted = 0;
+        world.tupleVersions[id]++;
+    }
+
+    // Tasks ----------------
+    /*
+     * Long running work (loading, pathfinding, scripted sequences) can be written as a coroutine returning mango::Task and started from a SunLambda or jolt
+     * A task runs until it co_awaits NextFrame(), WaitFrames(n), WaitStage(stage) or RunJob(job) and is then resumed by the loop on the game thread
+     * Tasks are resumed right before the first schedule of the stage they wait for, or at the end of the frame when no schedule has that stage
+     * Tasks need C++20, without coroutine support only the stage bookkeeping is compiled
+     */
+    static constexpr uint8_t StageAfterFrame = std::numeric_limits<uint8_t>::max();
+
+#ifdef __cpp_impl_coroutine
+    // Tasks are detached, the coroutine frame is freed when the task returns
+    struct Task
+    {
+        struct promise_type
+        {
+            Task get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception()
+            {
+                try
+                {
+                    throw;
+                }
+                catch (const std::exception& e)
+                {
+                    std::cout << "Task threw " << e.what() << std::endl;
+                }
+            }
+        };
+    };
+
+    struct SuspendedTask
+    {
+        std::coroutine_handle<> handle;
+        uint64_t frame;
+        uint8_t stage;
+        // Set by the worker when the task waits for a job
+        std::shared_ptr<std::atomic<bool>> job;
+    };
+
+    struct StageAwaiter
+    {
+        uint64_t frame;
+        uint8_t stage;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) const { GetWorld().suspendedTasks.push_back({handle, frame, stage, nullptr}); }
+        void await_resume() const noexcept {}
+    };
+
+    struct JobAwaiter
+    {
+        std::function<void()> job;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            World& world = GetWorld();
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            world.suspendedTasks.push_back({handle, 0, 0, done});
+            world.jobs.push(JobPool::shared(), [job = std::move(job), done]{ job(); done->store(true, std::memory_order_release); });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // Resume at the same stage of a later frame
+    static StageAwaiter WaitFrames(uint64_t frames)
+    {
+        World& world = GetWorld();
+        return {world.frame + frames, world.stage};
+    }
+
+    static StageAwaiter NextFrame()
+    {
+        return WaitFrames(1);
+    }
+
+    // Resume at stage this frame if it hasn't been acted yet, otherwise next frame
+    static StageAwaiter WaitStage(LOOP_TIMES stage)
+    {
+        World& world = GetWorld();
+        return {stage > world.stage ? world.frame : world.frame + 1, stage};
+    }
+
+    // The job runs on a worker thread and the task is resumed on the game thread at the first stage after it finished
+    // It must not touch props, the world isn't locked while the loop keeps going
+    static JobAwaiter RunJob(std::function<void()> job)
+    {
+        return {std::move(job)};
+    }
+
+    static bool IsDue(World& world, const SuspendedTask& task)
+    {
+        if (task.job) return task.job->load(std::memory_order_acquire);
+        return task.frame < world.frame || (task.frame == world.frame && task.stage <= world.stage);
+    }
+
+    static void ResumeTasks(World& world)
+    {
+        if (world.suspendedTasks.empty()) return;
+        // Resumed tasks may suspend again, so the due ones are taken out first
+        auto due = std::stable_partition(world.suspendedTasks.begin(), world.suspendedTasks.end(), [&world](const SuspendedTask& task)
+        {
+            return !IsDue(world, task);
+        });
+        if (due == world.suspendedTasks.end()) return;
+        std::vector<SuspendedTask> resuming(due, world.suspendedTasks.end());
+        world.suspendedTasks.erase(due, world.suspendedTasks.end());
+        for (SuspendedTask& task : resuming) task.handle.resume();
+    }
+
+    static bool HasSuspendedTasks(World& world)
+    {
+        return !world.suspendedTasks.empty();
+    }
+
+    // Jobs may still be using the frames of their tasks, so they are finished before any task is destroyed
+    static void DestroyTasks(World& world)
+    {
+        world.jobs.wait();
+        for (SuspendedTask& task : world.suspendedTasks) task.handle.destroy();
+        world.suspendedTasks.clear();
+    }
+#else
+    static bool HasSuspendedTasks(World&) { return false; }
+    static void ResumeTasks(World&) {}
+    static void DestroyTasks(World&) {}
+#endif
+
+    // Events ----------------
+    /*
+     * One frame messages (hits, sounds, input...) that skip props, staging and novel tuples entirely
+     * Events sent during a frame are read with Events by SunLambdas scheduled later in the same frame, and with PreviousEvents by SunLambdas scheduled earlier on the next frame
+     * After that they are dropped, the two buffers of a channel are swapped at the end of every loop on the loop thread and keep their capacity
+     * Pipelined presentation SunLambdas read a copy of the channels taken with the props snapshot, events they send are only seen by the presentation SunLambdas after them
+     * A SunLambda is kept out of fused runs from the first frame it sends or reads events on, see Fuse
+     */
+    template <typename EventType>
+    struct EventSpan
+    {
+        const EventType* data;
+        size_t count;
+
+        const EventType* begin() const { return data; }
+        const EventType* end() const { return data + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const EventType& operator[](size_t i) const { return data[i]; }
+    };
+
+    template <typename EventType>
+    struct EventChannel
+    {
+        std::vector<EventType> current;
+        std::vector<EventType> previous;
+        // The presented frame a snapshot was taken on, snapshots of channels the loop thread never used are emptied per frame instead
+        uint64_t frame = 0;
+    };
+
+    template <typename EventType>
+    static EventChannel<EventType>& GetEventChannel()
+    {
+        using Channel = EventChannel<EventType>;
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local Channel* cached = nullptr;
+        static thread_local SunLambda::Id user = sun_lambda_none;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            const size_t type = std::type_index(typeid(EventType)).hash_code();
+            cached = &FindStorage<Channel>(world.eventStorage, type);
+            cachedSerial = world.serial;
+            user = sun_lambda_none;
+            if (!world.eventAdvanceFunctions.count(type))
+            {
+                world.eventAdvanceFunctions[type] = [&channel = *cached]
+                {
+                    std::swap(channel.current, channel.previous);
+                    channel.current.clear();
+                };
+                world.eventSnapshotFunctions[type] = [&channel = *cached]
+                {
+                    Channel& snapshot = GetEventSnapshot<EventType>();
+                    snapshot.current = channel.current;
+                    snapshot.previous = channel.previous;
+                    snapshot.frame = GetWorld().frame;
+                };
+            }
+        }
+        if (acting != user && acting != sun_lambda_none)
+        {
+            world.eventUsers.insert(acting);
+            user = acting;
+        }
+        return *cached;
+    }
+
+    // Only touched by the presentation thread while it presents, and by the loop thread while it doesn't
+    template <typename EventType>
+    static EventChannel<EventType>& GetEventSnapshot()
+    {
+        using Channel = EventChannel<EventType>;
+        static thread_local uint64_t cachedSerial = 0;
+        static thread_local Channel* cached = nullptr;
+        World& world = GetWorld();
+        if (cachedSerial != world.serial)
+        {
+            cached = &FindStorage<Channel>(world.eventSnapshotStorage, std::type_index(typeid(EventType)).hash_code());
+            cachedSerial = world.serial;
+        }
+        Channel& snapshot = *cached;
+        if (presenting && snapshot.frame != world.presentationFrame)
+        {
+            snapshot.current.clear();
+            snapshot.previous.clear();
+            snapshot.frame = world.presentationFrame;
+        }
+        return snapshot;
+    }
+
+    static void AdvanceEvents(World& world)
+    {
+        for (auto& [type, advance] : world.eventAdvanceFunctions)
+        {
+            advance();
+        }
+    }
+
+    template <typename EventType>
+    static void SendEvent(EventType event)
+    {
+        (presenting ? GetEventSnapshot<EventType>() : GetEventChannel<EventType>()).current.push_back(std::move(event));
+    }
+
+    // The span is only valid until the next event of this type is sent
+    template <typename EventType>
+    static EventSpan<EventType> Events()
+    {
+        const std::vector<EventType>& events = (presenting ? GetEventSnapshot<EventType>() : GetEventChannel<EventType>()).current;
+        return {events.data(), events.size()};
+    }
+
+    template <typename EventType>
+    static EventSpan<EventType> PreviousEvents()
+    {
+        const std::vector<EventType>& events = (presenting ? GetEventSnapshot<EventType>() : GetEventChannel<EventType>()).previous;
+        return {events.data(), events.size()};
+    }
+
+    // Schedule fusion ----------------
+    struct FusionCheck
+    {
+        uint64_t versionA = 0;
+        uint64_t versionB = 0;
+        bool checked = false;
+        bool match = false;
+    };
+
+    // Adjacent schedules over the same novel tuples are acted block by block, every SunLambda of the run acts a block before moving on to the next one while its props are still in cache
+    static constexpr size_t FusionBlock = 64;
+
+    /*
+     * Let a SunLambda join fused runs
+     * Only opt in SunLambdas that touch nothing but their own tuple: a SunLambda that sends or reads events, calls GetProps or GetWorld, or reads another tuple's props would see the run half done
+     */
+    static void Fuse(SunLambda::Id id)
+    {
+        GetWorld().fused.insert(id);
+    }
+
+    static void Unfuse(SunLambda::Id id)
+    {
+        GetWorld().fused.erase(id);
+    }
+
+    // Only unconstrained SunLambdas qualify, since a tuple of theirs never shares props with another tuple
+    static bool IsFusable(World& world, const SunSchedule& schedule)
+    {
+        if (!world.fused.count(schedule.id) || world.changeTrackers.count(schedule.id) || schedule.slices > 1) return false;
+        // A SunLambda that reads events would see only the events sent on the blocks acted before it
+        if (world.eventUsers.count(schedule.id)) return false;
+        // SunLambdas of resources alone have no tuples to act in blocks
+        if (TypesetOf(schedule.id).empty()) return false;
+        // Sorted tuples are reordered right before they're acted
+        if (world.sortOrders.count(schedule.id)) return false;
+        auto creator = world.novelTupleCreators.find(schedule.id);
+        return creator == world.novelTupleCreators.end() || (!creator->second.compatible && creator->second.reuseOnStages.empty());
+    }
+
+    // Props are matched the same way for unconstrained SunLambdas of the same typeset, but Rematch can reorder the tuples of one of them
+    static bool TuplesMatch(World& world, SunLambda::Id a, SunLambda::Id b)
+    {
+        a = TableOf(world, a);
+        b = TableOf(world, b);
+        if (a == b) return true;
+        FusionCheck& check = world.fusionChecks[{a, b}];
+        const uint64_t versionA = world.tupleVersions[a];
+        const uint64_t versionB = world.tupleVersions[b];
+        if (check.checked && check.versionA == versionA && check.versionB == versionB) return check.match;
+        const auto& tuplesA = world.novelTuples[a];
+        const auto& tuplesB = world.novelTuples[b];
+        bool match = tuplesA.size() == tuplesB.size();
+        for (size_t t = 0; match && t < tuplesA.size(); t++)
+        {
+            for (size_t i = 0; i < tuplesA[t].size(); i++)
+            {
+                if (tuplesA[t][i].id != tuplesB[t][i].id)
+                {
+                    match = false;
+                    break;
+                }
+            }
+        }
+        check = {versionA, versionB, true, match};
+        return match;
+    }
+
+    // The number of schedules from first on that are acted together
+    static size_t FusedRun(World& world, size_t first)
+    {
+        const SunSchedule& lead = world.schedules[first];
+        if (!IsFusable(world, lead)) return 1;
+        const Typeset& typeset = TypesetOf(lead.id);
+        std::set<PropTypeId> taken;
+        std::set<PropTypeId> written;
+        TakeResources(lead.id, taken, written);
+        size_t run = 1;
+        for (size_t s = first + 1; s < world.schedules.size(); s++, run++)
+        {
+            const SunSchedule& next = world.schedules[s];
+            if (next.interval != lead.interval || next.phase != lead.phase || !IsFusable(world, next) || TypesetOf(next.id) != typeset) break;
+            if (world.pipelined && IsPresentation(next)) break;
+            // Suspended tasks are resumed between stages
+            if (next.specificity.specificity[0] != lead.specificity.specificity[0] && HasSuspendedTasks(world)) break;
+            if (!TuplesMatch(world, lead.id, next.id)) break;
+            if (!TakeResources(next.id, taken, written)) break;
+        }
+        return run;
+    }
+
+    // Fused SunLambdas take turns on each block, so one that writes a resource would be seen half written by the others
+    // False if the SunLambda writes a resource the run takes or takes a resource the run writes, otherwise its resources join the run's
+    static bool TakeResources(SunLambda::Id id, std::set<PropTypeId>& taken, std::set<PropTypeId>& written)
+    {
+        static const std::vector<PropTypeId> none;
+        auto resources = sunLambdaResources.find(id);
+        auto writes = sunLambdaWrittenResources.find(id);
+        const std::vector<PropTypeId>& takes = resources != sunLambdaResources.end() ? resources->second : none;
+        const std::vector<PropTypeId>& writing = writes != sunLambdaWrittenResources.end() ? writes->second : none;
+        for (PropTypeId ptid : takes)
+        {
+            if (written.count(ptid)) return false;
+        }
+        for (PropTypeId ptid : writing)
+        {
+            if (taken.count(ptid)) return false;
+        }
+        taken.insert(takes.begin(), takes.end());
+        written.insert(writing.begin(), writing.end());
+        return true;
+    }
+
+    static void ActFused(World& world, size_t first, size_t run)
+    {
+        const SunSchedule& lead = world.schedules[first];
+        if (!RunsOn(lead, world.frame)) return;
+        auto& registry = SunLambdaRegistry::GetInstance();
+        const size_t count = TuplesOf(world, lead.id).size();
+        for (size_t begin = 0; begin < count; begin += FusionBlock)
+        {
+            currentBlock = {begin, begin + FusionBlock};
+            for (size_t s = first; s < first + run; s++)
+            {
+                // A run can span stages, each SunLambda sees its own like it would unfused
+                world.stage = world.schedules[s].specificity.specificity[0];
+                acting = world.schedules[s].id;
+                Timed(world.schedules[s].id, registry.Get(world.schedules[s].id));
+            }
+        }
+        currentBlock = TupleBlock{0, SIZE_MAX};
+        acting = sun_lambda_none;
+    }
+
+    // Replication ----------------
+    /*
+     * Prop types opted in with Replicate are journaled into a compact binary stream
+     * Each frame appends the props created, removed and staged in order, then the bytes of every prop written during the frame and a frame marker
+     * Send TakeJournal() during NETWORK_SEND (or after Loop) and replay it with ApplyJournal in another world that replicates the same prop types
+     */
+    enum class JournalOp : uint8_t
+    {
+        Frame,
+        Create,
+        Remove,
+        Stage,
+        Update
+    };
+
+    // The journal collects changed props as a change tracking subscriber of its prop types
+    static constexpr SunLambda::Id journal_subscriber = sun_lambda_none - 1;
+
+    struct JournalType
+    {
+        size_t size;
+        std::function<void(PropIdRaw, std::vector<uint8_t>&)> write;
+        std::function<void(PropIdRaw, const uint8_t*)> read;
+        std::function<PropIdRaw()> allocate;
+    };
+
+    // Props that exist before their type is replicated are not journaled until they change, their first Update creates them on the replica (without stages)
+    template <typename PropType>
+    static void Replicate()
+    {
+        static_assert(std::is_trivially_copyable_v<PropType>, "Replicated props are journaled as raw bytes");
+        World& world = GetWorld();
+        const PropTypeId ptid = GetPropTypeId<PropType>();
+        world.journalTypes[ptid] = {
+            sizeof(PropType),
+            [](PropIdRaw pidr, std::vector<uint8_t>& out)
+            {
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&GetProps<PropType>()[pidr]);
+                out.insert(out.end(), bytes, bytes + sizeof(PropType));
+            },
+            [](PropIdRaw pidr, const uint8_t* bytes)
+            {
+                std::memcpy(&GetProps<PropType>()[pidr], bytes, sizeof(PropType));
+            },
+            []{ return GetProps<PropType>().next().first; }
+        };
+        world.dirtyProps[ptid][journal_subscriber];
+    }
+
+    // Everything journaled since the last call
+    static std::vector<uint8_t> TakeJournal()
+    {
+        return std::move(GetWorld().journal);
+    }
+
+    static void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Journals come from the network, so every read is bounded by end and fails rather than reading past it
+    static bool ReadVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && in < end; shift += 7)
+        {
+            const uint8_t byte = *in++;
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Prop type ids are hashes, so they are written in full
+    static void WriteJournalProp(std::vector<uint8_t>& out, JournalOp op, GlobalPropId gpid)
+    {
+        out.push_back(static_cast<uint8_t>(op));
+        for (size_t b = 0; b < sizeof(PropTypeId); b++) out.push_back(static_cast<uint8_t>(gpid.typeId >> (b * 8)));
+        WriteVarint(out, gpid.id);
+    }
+
+    static bool ReadJournalProp(const uint8_t*& in, const uint8_t* end, GlobalPropId& gpid)
+    {
+        gpid = {0, 0};
+        if (static_cast<size_t>(end - in) < sizeof(PropTypeId)) return false;
+        for (size_t b = 0; b < sizeof(PropTypeId); b++) gpid.typeId |= PropTypeId(*in++) << (b * 8);
+        uint64_t id;
+        if (!ReadVarint(in, end, id)) return false;
+        gpid.id = id;
+        return true;
+    }
+
+    static bool ReadJournalStage(const uint8_t*& in, const uint8_t* end, Stage& stage)
+    {
+        uint64_t group, instance;
+        if (!ReadVarint(in, end, group) || !ReadVarint(in, end, instance)) return false;
+        stage = {static_cast<Group>(group), static_cast<Instance>(instance)};
+        return true;
+    }
+
+    // Walks a journal without applying it, so that a truncated or corrupt journal is rejected as a whole
+    static bool CheckJournal(World& world, const uint8_t* in, const uint8_t* end)
+    {
+        while (in < end)
+        {
+            const JournalOp op = static_cast<JournalOp>(*in++);
+            uint64_t count;
+            if (op == JournalOp::Frame)
+            {
+                if (!ReadVarint(in, end, count)) return false;
+                continue;
+            }
+            GlobalPropId remote;
+            if (!ReadJournalProp(in, end, remote)) return false;
+            auto type = world.journalTypes.find(remote.typeId);
+            if (type == world.journalTypes.end())
+            {
+                std::cout << "Journal contains a prop type that is not replicated by this world" << std::endl;
+                return false;
+            }
+            Stage stage;
+            switch (op)
+            {
+                case JournalOp::Create:
+                    if (!ReadVarint(in, end, count)) return false;
+                    for (; count > 0; count--)
+                    {
+                        if (!ReadJournalStage(in, end, stage)) return false;
+                    }
+                    break;
+                case JournalOp::Remove:
+                    break;
+                case JournalOp::Stage:
+                    if (!ReadJournalStage(in, end, stage)) return false;
+                    break;
+                case JournalOp::Update:
+                    if (static_cast<size_t>(end - in) < type->second.size) return false;
+                    in += type->second.size;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    static void JournalCreate(World& world, const DelayedPropCreator& creator)
+    {
+        if (!world.journalTypes.count(creator.gpid.typeId)) return;
+        WriteJournalProp(world.journal, JournalOp::Create, creator.gpid);
+        WriteVarint(world.journal, creator.stages.size());
+        for (const Stage& stage : creator.stages)
+        {
+            WriteVarint(world.journal, stage.group);
+            WriteVarint(world.journal, stage.instance);
+        }
+    }
+
+    static void JournalRemove(World& world, GlobalPropId gpid)
+    {
+        if (!world.journalTypes.count(gpid.typeId)) return;
+        WriteJournalProp(world.journal, JournalOp::Remove, gpid);
+    }
+
+    static void JournalStage(World& world, GlobalPropId gpid, const Stage& stage)
+    {
+        if (!world.journalTypes.count(gpid.typeId)) return;
+        WriteJournalProp(world.journal, JournalOp::Stage, gpid);
+        WriteVarint(world.journal, stage.group);
+        WriteVarint(world.journal, stage.instance);
+    }
+
+    // Props created this frame are dirty too, so their first Update carries their bytes
+    static void FlushJournal(World& world)
+    {
+        if (world.journalTypes.empty()) return;
+        for (auto& [ptid, type] : world.journalTypes)
+        {
+            DynamicBitset& dirty = world.dirtyProps[ptid][journal_subscriber];
+            dirty.forEach([&world, &type = type, ptid = ptid](size_t pidr)
+            {
+                WriteJournalProp(world.journal, JournalOp::Update, {ptid, pidr});
+                type.write(pidr, world.journal);
+            });
+            dirty.clear();
+        }
+        world.journal.push_back(static_cast<uint8_t>(JournalOp::Frame));
+        WriteVarint(world.journal, world.frame);
+    }
+
+    /*
+     * Replay a journal taken from another world into the current world
+     * Raw ids are translated because the two worlds allocate props independently
+     * Created props land with the next CreatePropsDelayed and removed props with the next RemovePropsDelayed, like AddProp and RemoveProps
+     */
+    static bool ApplyJournal(const uint8_t* data, size_t size)
+    {
+        World& world = GetWorld();
+        const uint8_t* in = data;
+        const uint8_t* end = data + size;
+        if (!CheckJournal(world, in, end))
+        {
+            std::cout << "Journal is corrupt or truncated, none of it is applied" << std::endl;
+            return false;
+        }
+        // The journal was checked, so none of the reads below can fail
+        while (in < end)
+        {
+            const JournalOp op = static_cast<JournalOp>(*in++);
+            if (op == JournalOp::Frame)
+            {
+                ReadVarint(in, end, world.replicaFrame);
+                continue;
+            }
+            GlobalPropId remote;
+            ReadJournalProp(in, end, remote);
+            const JournalType& type = world.journalTypes.find(remote.typeId)->second;
+            auto& ids = world.replicaIds[remote.typeId];
+            // Props the other world had before replicating their type were never journaled as created
+            auto local = ids.find(remote.id);
+            switch (op)
+            {
+                case JournalOp::Create:
+                {
+                    DelayedPropCreator creator{{remote.typeId, type.allocate()}, {}};
+                    uint64_t stages;
+                    ReadVarint(in, end, stages);
+                    for (; stages > 0; stages--)
+                    {
+                        Stage stage;
+                        ReadJournalStage(in, end, stage);
+                        creator.stages.insert(stage);
+                    }
+                    ids[remote.id] = creator.gpid.id;
+                    world.propsToAdd.push_back(std::move(creator));
+                    world.queuedCreations++;
+                    break;
+                }
+                case JournalOp::Remove:
+                {
+                    if (local == ids.end()) break;
+                    // A prop whose creation hasn't landed yet isn't staged or matched, so it is dropped rather than queued for removal
+                    if (DelayedPropCreator* pending = FindPendingCreation(world, {remote.typeId, local->second}))
+                    {
+                        CancelCreation(world, *pending);
+                    }
+                    else
+                    {
+                        QueueRemoval(world, remote.typeId, local->second);
+                    }
+                    ids.erase(local);
+                    break;
+                }
+                case JournalOp::Stage:
+                {
+                    Stage stage;
+                    ReadJournalStage(in, end, stage);
+                    if (local == ids.end()) break;
+                    if (DelayedPropCreator* pending = FindPendingCreation(world, {remote.typeId, local->second}))
+                    {
+                        pending->stages.insert(stage);
+                    }
+                    else
+                    {
+                        AddPropStage({remote.typeId, local->second}, stage);
+                    }
+                    break;
+                }
+                case JournalOp::Update:
+                {
+                    // An unknown prop is created by its first update, without stages since they were never journaled
+                    if (local == ids.end())
+                    {
+                        DelayedPropCreator creator{{remote.typeId, type.allocate()}, {}};
+                        local = ids.emplace(remote.id, creator.gpid.id).first;
+                        world.propsToAdd.push_back(std::move(creator));
+                        world.queuedCreations++;
+                    }
+                    type.read(local->second, in);
+                    in += type.size;
+                    MarkDirty(remote.typeId, local->second);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+
+    static bool ApplyJournal(const std::vector<uint8_t>& journal)
+    {
+        return ApplyJournal(journal.data(), journal.size());
+    }
+
+    // World ----------------
+    /*
+     * A World owns everything that changes while a game runs: props, their stages, novel tuples, schedules and jolts
+     * SunLambdas and their typesets are shared by every world since they're declared once during static initialization
+     * The static mango API acts on the world bound to the calling thread, which is the default world unless a WorldScope binds another one
+     * Worlds share nothing mutable, so different worlds can Loop() at the same time on different threads
+     */
+    static inline std::atomic<uint64_t> worldSerials{0};
+
+    struct World
+    {
+        // The number of loops that have been run
+        uint64_t frame = 0;
+
+        // The LOOP_TIMES stage being acted, StageAfterFrame once every schedule of the frame is done
+        uint8_t stage = FORAGE;
+
+        // Should the gameplay loop of this world stop? Set from the presentation thread too when pipelined, see Brake
+        std::atomic<bool> brake{false};
+
+#ifdef __cpp_impl_coroutine
+        std::vector<SuspendedTask> suspendedTasks;
+        // This world's jobs, they run on the pool shared by every world
+        JobGroup jobs;
+#endif
+
+        std::vector<SunSchedule> schedules;
+
+        // Emerges are called when a novel tuple is formed
+        std::set<SunLambda::Id> emerges;
+
+        // Breakups are called when a one or more of the props in a novel tuple are removed
+        std::set<SunLambda::Id> breakups;
+
+        // Batched jolts are called once per frame with every tuple that emerged or broke up instead of once per tuple
+        std::set<SunLambda::Id> batchedJolts;
+
+        // The PropIdRaw of each pending tuple, laid out back to back in typeset order
+        std::unordered_map<SunLambda::Id, std::vector<size_t>> pendingEmerges;
+
+        std::unordered_map<SunLambda::Id, std::vector<size_t>> pendingBreakups;
+
+        // Shared between emerge/plan/breakup: we assume a SunLambda cannot have multiple NovelTupleCreators for now
+        std::unordered_map<SunLambda::Id, NovelTupleCreator> novelTupleCreators;
+
+        // This data structure is an augment of potential neighbors when searching for props to form novel tuples
+        std::unordered_map<SunLambda::Id, std::unordered_map<PropTypeId, std::vector<PropIdRaw>>> partialStatics;
+
+        std::unordered_map<PropTypeId, std::unordered_map<PropIdRaw, std::set<Stage>>> ptpsq; // Prop type prop stages query
+
+        // Each SunLambda stores a map of props of types in its typeset which have been added but not formed into novel tuples yet
+        // Partial static indicators that return true indicate that a prop can be reused in multiple novel tuples of the same SunLambda
+        std::map<SunLambda::Id, std::unordered_map<PropTypeId, std::vector<PropIdRaw>>> stagingPropTuples;
+
+        std::map<SunLambda::Id, std::vector<std::vector<GlobalPropId>>> novelTuples;
+
+        // Prop types are registered per world the first time GetPropTypeId sees them
+        std::unordered_map<PropTypeId, std::function<void(PropIdRaw)>> freeFunctions;
+
+        std::unordered_map<PropTypeId, std::string> propTypeNames;
+
+        std::unordered_map<Group, IdPool<Instance, true, true>> instanceBuffer;
+        // The number of props staged on each instance of each group
+        std::unordered_map<Group, std::vector<uint32_t>> stageUsers;
+
+        std::vector<DelayedPropCreator> propsToAdd;
+
+        // Delay prop removal until the end of the current frame
+        std::unordered_map<PropTypeId, std::set<PropIdRaw>> propsToRemove;
+
+        std::unordered_map<SunLambda::Id, std::set<size_t>> tuplesToBreakup;
+
+        // The props staged on each group
+        std::unordered_map<Group, std::unordered_map<PropTypeId, DynamicBitset>> groupProps;
+        std::set<Group> destroyingGroups;
+
+        std::unordered_map<PropTypeId, JournalType> journalTypes;
+        std::vector<uint8_t> journal;
+        // Raw ids of props replayed from another world's journal to their raw ids in this world
+        std::unordered_map<PropTypeId, std::unordered_map<PropIdRaw, PropIdRaw>> replicaIds;
+        // The last frame of the other world that was applied
+        uint64_t replicaFrame = 0;
+
+        MatchCounters matchCounters;
+        FrameMatchStats matchStats;
+        std::unordered_map<SunLambda::Id, StagingGrowth> stagingGrowth;
+
+        // Bumped whenever the novel tuples of a SunLambda change
+        std::unordered_map<SunLambda::Id, uint64_t> tupleVersions;
+        std::map<std::pair<SunLambda::Id, SunLambda::Id>, FusionCheck> fusionChecks;
+        // SunLambdas opted into fused runs with Fuse
+        std::set<SunLambda::Id> fused;
+        std::unordered_map<PropTypeId, std::function<void()>> clearFunctions;
+
+        // Props queued for removal in order, those before removalCursor have been removed
+        std::vector<GlobalPropId> removalQueue;
+        size_t removalCursor = 0;
+        // Removals before this index are applied in one chunk, see DestroyGroup
+        size_t unsplitRemovals = 0;
+
+        // Props whose removal was carried over by the removal budget are hidden from SunLambdas and novel tuple searches until they are removed
+        std::unordered_map<PropTypeId, DynamicBitset> hiddenProps;
+
+        // Props before creationCursor in propsToAdd have been considered
+        size_t creationCursor = 0;
+
+        DelayedBudget createBudget;
+        DelayedBudget removeBudget;
+
+        // Running totals used to tell when a PropBatch has landed
+        uint64_t queuedCreations = 0;
+        uint64_t appliedCreations = 0;
+        uint64_t queuedRemovals = 0;
+        uint64_t appliedRemovals = 0;
+        std::vector<std::pair<PropBatch, std::function<void()>>> landingCallbacks;
+
+        std::unordered_map<PropTypeId, std::function<MemoryStats()>> memoryFunctions;
+
+        size_t propStagesPeak = 0;
+
+        std::unordered_map<SunLambda::Id, size_t> novelTuplePeaks;
+
+        std::unordered_map<SunLambda::Id, size_t> stagingPeaks;
+
+        std::unordered_map<SunLambda::Id, size_t> partialStaticPeaks;
+
+        // Run the presentation stages on a second thread, see PresentPipelined
+        bool pipelined = false;
+
+        // Copies the live props of a type into its snapshot, registered alongside freeFunctions
+        std::unordered_map<PropTypeId, std::function<void()>> snapshotFunctions;
+
+        std::unordered_map<SunLambda::Id, std::vector<std::vector<GlobalPropId>>> presentationTuples;
+
+        std::vector<Presentation> presentations;
+
+        uint64_t presentationFrame = 0;
+
+        sf::Time presentationDelta;
+
+        std::thread presenter;
+
+        std::mutex presenterMutex;
+
+        std::condition_variable presenterSignal;
+
+        bool presentationPending = false;
+
+        bool stopPresenting = false;
+
+        // Every prop type has a version that is bumped whenever one of its props may have been written to
+        std::unordered_map<PropTypeId, uint64_t> changeVersions;
+
+        // SunLambdas that only iterate novel tuples where at least one prop changed since they last ran
+        std::set<SunLambda::Id> changeTrackers;
+
+        // For each prop type, one bit per PropIdRaw that changed since each change tracking SunLambda last ran
+        std::unordered_map<PropTypeId, DirtySubscribers> dirtyProps;
+
+        // The prop type versions a change tracking SunLambda saw when it last ran, so it can skip a frame where nothing in its typeset changed
+        std::unordered_map<SunLambda::Id, std::unordered_map<PropTypeId, uint64_t>> seenChangeVersions;
+
+        // Type erased SparseArray or PagedArray per prop type
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> propStorage;
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> snapshotStorage;
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> eventStorage;
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> eventSnapshotStorage;
+        // Registered the first time the loop thread uses a channel, see GetEventChannel
+        std::unordered_map<PropTypeId, std::function<void()>> eventAdvanceFunctions;
+        std::unordered_map<PropTypeId, std::function<void()>> eventSnapshotFunctions;
+        // SunLambdas that sent or read events while acted, they are kept out of fused runs
+        std::set<SunLambda::Id> eventUsers;
+        std::unordered_map<SunLambda::Id, SortOrder> sortOrders;
+
+        // SunLambdas that share the tuple table of another and the SunLambdas sharing each owner's table
+        std::unordered_map<SunLambda::Id, SunLambda::Id> tableOwners;
+        std::unordered_map<SunLambda::Id, std::vector<SunLambda::Id>> tableSharers;
+        std::set<SunLambda::Id> placedTables;
+
+        // Lazy SunLambdas that haven't been planned, jolted or iterated yet and the props they haven't matched
+        std::set<SunLambda::Id> dormant;
+        std::unordered_map<SunLambda::Id, std::unordered_map<PropTypeId, std::vector<PropIdRaw>>> pendingMatches;
+
+        // Live stats segment and the nanoseconds each SunLambda acted for this frame, see OpenStats
+        StatsSegment stats;
+        std::unordered_map<SunLambda::Id, uint64_t> actTimes;
+        std::unordered_map<SunLambda::Id, uint64_t> presentationTimes;
+        std::unordered_map<SunLambda::Id, uint64_t> presentedTimes;
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> resourceStorage;
+        std::unordered_map<PropTypeId, std::shared_ptr<void>> resourceSnapshotStorage;
+
+        // One bit per instance of each group for every tag
+        std::unordered_map<PropTypeId, std::unordered_map<Group, DynamicBitset>> tagStages;
+        std::vector<std::pair<PropTypeId, GroupSet>> tagsToAdd;
+        std::vector<std::pair<PropTypeId, Stage>> tagsToRemove;
+
+        // Never reused, so a thread's cached storage lookup can't mistake a new world for a destroyed one at the same address
+        const uint64_t serial = ++worldSerials;
+
+        void Loop()
+        {
+            WorldScope scope(*this);
+            mango::Loop();
+        }
+
+        ~World()
+        {
+            WorldScope scope(*this);
+            StopPipeline();
+            DestroyTasks(*this);
+            stats.Close();
+        }
+    };
+
+    static inline thread_local World* current = nullptr;
+
+    static World& DefaultWorld()
+    {
+        static World world;
+        return world;
+    }
+
+    static World& GetWorld()
+    {
+        return current ? *current : DefaultWorld();
+    }
+
+    // Binds a world to the calling thread for the lifetime of the scope
+    struct WorldScope
+    {
+        World* previous;
+
+        WorldScope(World& world) : previous(current)
+        {
+            current = &world;
+        }
+
+        ~WorldScope()
+        {
+            current = previous;
+        }
+    };
+
+private:
+
+    template <typename PropType>
+    static DirtySubscribers* WrittenSubscribers(PropTypeId ptid)
+    {
+        World& world = GetWorld();
+        if constexpr (IsWrittenProp<PropType>)
+        {
+            // Versions only need to say that something changed, so bump once per IterateProps rather than per tuple
+            world.changeVersions[ptid]++;
+            auto subscribers = world.dirtyProps.find(ptid);
+            if (subscribers != world.dirtyProps.end() && !subscribers->second.empty()) return &subscribers->second;
+        }
+        return nullptr;
+    }
+
+    static void MarkWritten(DirtySubscribers* subscribers, PropIdRaw pidr, SunLambda::Id writer)
+    {
+        if (!subscribers) return;
+        for (auto& [sunid, dirty] : *subscribers)
+        {
+            if (sunid != writer) dirty.set(pidr);
+        }
+    }
+
+    // Presentation SunLambdas read the snapshot taken for the presentation thread
+    template <typename PropType>
+    static typename PropStorage<PropType>::type& IterationProps()
+    {
+        return presenting ? GetPropsSnapshot<PropType>() : GetProps<PropType>();
+    }
+
+    static DynamicBitset* FindHidden(World& world, PropTypeId ptid)
+    {
+        auto hidden = world.hiddenProps.find(ptid);
+        return hidden != world.hiddenProps.end() ? &hidden->second : nullptr;
+    }
+
+    // Calls visit with each novel tuple of the current slice, skipping unchanged tuples for change tracking SunLambdas
+    template <typename ... PTypes, typename Visit, std::size_t ... Is>
+    static void VisitTuples(const SunLambda::Id& id, Visit&& visit, std::index_sequence<Is...> /*seq*/)
+    {
+        World& world = GetWorld();
+        if (presenting)
+        {
+            // Only touch state that was snapshot for the presentation thread
+            auto& tuples = world.presentationTuples.find(id)->second;
+            const size_t begin = tuples.size() * currentSlice.index / currentSlice.count;
+            const size_t end = tuples.size() * (currentSlice.index + 1) / currentSlice.count;
+            for (size_t t = begin; t < end; t++)
+            {
+                visit(tuples[t]);
+            }
+            return;
+        }
+
+        Wake(world, id);
+        const Typeset& typeset = TypesetOf(id);
+        const bool onlyChanged = world.changeTrackers.count(id) > 0;
+        if (onlyChanged && !HasChanges(id)) return;
+        // Slices after the first keep the order the first one saw
+        if (currentSlice.index == 0) KeepSorted(world, id);
+
+        std::array<DynamicBitset*, sizeof...(PTypes)> dirty = {};
+        if (onlyChanged) dirty = {&world.dirtyProps[typeset[Is]][id]...};
+        std::array<DirtySubscribers*, sizeof...(PTypes)> written = {WrittenSubscribers<PTypes>(typeset[Is])...};
+
+        // Props whose removal was carried over by the removal budget
+        const bool anyHidden = world.removalCursor < world.removalQueue.size();
+        std::array<DynamicBitset*, sizeof...(PTypes)> hidden = {};
+        if (anyHidden) hidden = {FindHidden(world, typeset[Is])...};
+
+        const bool tagged = !TagsOf(id).empty();
+
+        auto& tuples = TuplesOf(world, id);
+        const bool sliced = currentSlice.count > 1;
+        const size_t begin = std::max(tuples.size() * currentSlice.index / currentSlice.count, currentBlock.begin);
+        const size_t end = std::min(tuples.size() * (currentSlice.index + 1) / currentSlice.count, currentBlock.end);
+        for (size_t t = begin; t < end; t++)
+        {
+            auto& tuple = tuples[t];
+            if (onlyChanged && !(dirty[Is]->test(tuple[Is].id) || ...)) continue;
+            if (anyHidden && ((hidden[Is] && hidden[Is]->test(tuple[Is].id)) || ...)) continue;
+            if (tagged && !HasTags(world, id, tuple)) continue;
+            visit(tuple);
+            (MarkWritten(written[Is], tuple[Is].id, id), ...);
+            // The rest of the dirty props belong to slices that haven't been visited yet
+            if (onlyChanged && sliced) (dirty[Is]->reset(tuple[Is].id), ...);
+        }
+
+        if (onlyChanged && !sliced)
+        {
+            for (DynamicBitset* d : dirty) d->clear();
+            // Recorded after our own writes so that a SunLambda never wakes itself up
+            for (PropTypeId ptid : typeset) world.seenChangeVersions[id][ptid] = world.changeVersions[ptid];
+        }
+    }
+
+    template <typename ... PTypes, typename Functor, std::size_t ... Is>
+    static auto IterateProps(Functor functor, const SunLambda::Id& id, std::index_sequence<Is...> seq)
+    {
+        auto props = std::forward_as_tuple(BindProp<PTypes>()...);
+        // Without any columns there are no tuples, a SunLambda of resources alone acts once (on the first slice)
+        if constexpr ((IsResource<PTypes> && ...))
+        {
+            if (currentSlice.index == 0) functor(std::get<Is>(props)...);
+        }
+        else
+        {
+            VisitColumns<Columns<PTypes...>>::Run(id, [&](const std::vector<GlobalPropId>& tuple)
+            {
+                functor(PropArg<Is, PTypes...>(props, [&tuple](size_t column){ return tuple[column].id; })...);
+            });
+        }
+    }
+
+    // Tuples are visited over the column types only
+    template <typename ColumnTypes>
+    struct VisitColumns;
+
+    template <typename... ColumnTypes>
+    struct VisitColumns<std::tuple<ColumnTypes...>>
+    {
+        template <typename Visit>
+        static void Run(const SunLambda::Id& id, Visit&& visit)
+        {
+            VisitTuples<ColumnTypes...>(id, visit, std::index_sequence_for<ColumnTypes...> {});
+        }
+    };
+
+    template <typename PropType, std::size_t Column>
+    static std::array<std::decay_t<PropType>, SunBlockSize>& BlockColumn()
+    {
+        static thread_local std::array<std::decay_t<PropType>, SunBlockSize> column;
+        return column;
+    }
+
+    // Grows to the largest batch of jolts seen, see CallBatchJolt
+    template <typename PropType, std::size_t Column>
+    static std::vector<std::decay_t<PropType>>& JoltColumn()
+    {
+        static thread_local std::vector<std::decay_t<PropType>> column;
+        return column;
+    }
+
+    // Props are wrapped in optionals inside their storage so they never sit contiguously, the rows are gathered into columns and written columns are scattered back
+    // A partial static written through a non-const column appears in several rows, the scatter keeps the value of its last row
+    template <typename ... PTypes, typename Functor, typename ColumnTuple, std::size_t ... Is>
+    static void ActColumns(Functor functor, const PropIdRaw* ids, size_t count, ColumnTuple columns, std::index_sequence<Is...> /*seq*/)
+    {
+        constexpr size_t width = sizeof...(PTypes);
+        auto props = std::forward_as_tuple(IterationProps<std::decay_t<PTypes>>()...);
+        for (size_t t = 0; t < count; t++)
+        {
+            ((std::get<Is>(columns)[t] = std::get<Is>(props)[ids[t * width + Is]]), ...);
+        }
+        functor(count, std::get<Is>(columns).data()...);
+        auto Scatter = [&](auto& storage, auto& column, size_t columnIndex, auto written)
+        {
+            if constexpr (decltype(written)::value)
+            {
+                for (size_t t = 0; t < count; t++) storage[ids[t * width + columnIndex]] = column[t];
+            }
+        };
+        (Scatter(std::get<Is>(props), std::get<Is>(columns), Is, std::bool_constant<IsWrittenProp<PTypes>>{}), ...);
+    }
+
+    template <typename ... PTypes, typename Functor, std::size_t ... Is>
+    static void ActBlock(Functor functor, const PropIdRaw* ids, size_t count, std::index_sequence<Is...> seq)
+    {
+        ActColumns<PTypes...>(functor, ids, count, std::forward_as_tuple(BlockColumn<PTypes, Is>()...), seq);
+    }
+
+    template <typename ... PTypes, typename Functor, std::size_t ... Is>
+    static void IterateBatch(Functor functor, const SunLambda::Id& id, std::index_sequence<Is...> seq)
+    {
+        static_assert((IsColumn<PTypes> && ...), "Batch SunLambdas can't take tags or resources");
+        constexpr size_t width = sizeof...(PTypes);
+        std::array<PropIdRaw, SunBlockSize * width> ids;
+        size_t count = 0;
+        VisitTuples<PTypes...>(id, [&](const std::vector<GlobalPropId>& tuple)
+        {
+            ((ids[count * width + Is] = tuple[Is].id), ...);
+            if (++count == SunBlockSize)
+            {
+                ActBlock<PTypes...>(functor, ids.data(), count, seq);
+                count = 0;
+            }
+        }, seq);
+        if (count > 0) ActBlock<PTypes...>(functor, ids.data(), count, seq);
+    }
+
+public:
+
+    template <typename ... PTypes>
+    static auto IterateProps(void (*functor)(PTypes...), const SunLambda::Id& id)
+    {
+        return IterateProps<PTypes...>(functor, id, std::index_sequence_for<PTypes...> {});
+    }
+
+    template <typename ... PTypes>
+    static void IterateBatch(BatchSignature<PTypes...>* functor, const SunLambda::Id& id)
+    {
+        IterateBatch<PTypes...>(functor, id, std::index_sequence_for<PTypes...> {});
+    }
+
+    // The SunLambda is a template argument rather than a pointer so the call is bound at compile time and can be inlined into the tuple loop
+    template <auto Functor>
+    static void IterateStatic(const SunLambda::Id& id)
+    {
+        IterateStatic<Functor>(Functor, id);
+    }
+
+    template <auto Functor, typename ... PTypes>
+    static void IterateStatic(void (*)(PTypes...), const SunLambda::Id& id)
+    {
+        IterateProps<PTypes...>([](PTypes... props){ Functor(std::forward<PTypes>(props)...); }, id, std::index_sequence_for<PTypes...> {});
+    }
+
+    // The batch SunLambda's parameter types can't be recovered from its column pointers, so they're passed along with it
+    template <auto Functor, typename ... PTypes>
+    static void IterateBatchStatic(const SunLambda::Id& id)
+    {
+        IterateBatch<PTypes...>([](size_t count, std::remove_reference_t<PTypes>*... columns){ Functor(count, columns...); }, id, std::index_sequence_for<PTypes...> {});
+    }
+
+    // Static pipelines ----------------
+    // A step of a static pipeline, Lambda is a type declared with DeclareSunLambda or DeclareBatchSunLambda
+    template <typename Lambda, uint8_t S0, uint8_t S1 = 0, uint8_t S2 = 0, uint8_t S3 = 0>
+    struct Step
+    {
+        using Type = Lambda;
+        static constexpr std::array<uint8_t, SpecificityDepth> specificity{S0, S1, S2, S3};
+    };
+
+    /*
+     * An alternative to Plan when the SunLambdas of a game are known at compile time
+     * The steps are ordered by specificity at compile time and Frame calls each of them directly, so there are no schedules or caller pointers left to go through
+     *
+     * using Game = mango::Pipeline<mango::Step<Move, UPDATE>, mango::Step<Draw, RENDER>>;
+     * while (!mango::Braking()) Game::Loop();
+     *
+     * Intervals, slices and pipelined presentation only apply to planned schedules, steps run every frame on the loop thread
+     * Like Loop, each step sets the world's stage and resumes the tasks waiting for it before it acts
+     * Hot reload builds still call the SunLambdas through the registry so that they can be swapped
+     */
+    template <typename... Steps>
+    struct Pipeline
+    {
+        static constexpr size_t size = sizeof...(Steps);
+
+        // Equal specificities keep their declaration order, like Plan
+        static constexpr std::array<size_t, size> Order()
+        {
+            std::array<std::array<uint8_t, SpecificityDepth>, size> specificities{Steps::specificity...};
+            std::array<size_t, size> order{};
+            for (size_t i = 0; i < size; i++) order[i] = i;
+            auto Before = [&specificities](size_t a, size_t b)
+            {
+                for (size_t x = 0; x < SpecificityDepth; x++)
+                {
+                    if (specificities[a][x] != specificities[b][x]) return specificities[a][x] < specificities[b][x];
+                }
+                return false;
+            };
+            for (size_t i = 1; i < size; i++)
+            {
+                for (size_t j = i; j > 0 && Before(order[j], order[j - 1]); j--)
+                {
+                    size_t swapped = order[j];
+                    order[j] = order[j - 1];
+                    order[j - 1] = swapped;
+                }
+            }
+            return order;
+        }
+
+        static void Frame()
+        {
+            Frame(GetWorld());
+        }
+
+        static void Frame(World& world)
+        {
+            Frame(world, std::make_index_sequence<size> {});
+        }
+
+        template <size_t... Is>
+        static void Frame(World& world, std::index_sequence<Is...>)
+        {
+            constexpr std::array<size_t, size> order = Order();
+            (ActStep<std::tuple_element_t<order[Is], std::tuple<Steps...>>>(world), ...);
+        }
+
+        template <typename S>
+        static void ActStep(World& world)
+        {
+            world.stage = S::specificity[0];
+            ResumeTasks(world);
+            S::Type::StaticAct();
+        }
+
+        static void Loop()
+        {
+            mango::Loop([](World& world){ Frame(world); });
+        }
+    };
+
+    // Jolts of batch SunLambdas get every tuple of the batch in one call, so 10k tuples emerging in a frame are one call rather than 10k
+    template <typename ... PTypes>
+    static void CallBatchJolt(BatchSignature<PTypes...>* functor, const PropIdRaw* sunData, size_t tupleCount)
+    {
+        CallBatchJolt<PTypes...>(functor, sunData, tupleCount, std::index_sequence_for<PTypes...> {});
+    }
+
+    template <typename ... PTypes, std::size_t ... Is>
+    static void CallBatchJolt(BatchSignature<PTypes...>* functor, const PropIdRaw* sunData, size_t tupleCount, std::index_sequence<Is...> seq)
+    {
+        static_assert((IsColumn<PTypes> && ...), "Batch SunLambdas can't take tags or resources");
+        (JoltColumn<PTypes, Is>().resize(tupleCount), ...);
+        ActColumns<PTypes...>(functor, sunData, tupleCount, std::forward_as_tuple(JoltColumn<PTypes, Is>()...), seq);
     }
-};
\ No newline at end of file
+};
@@ -5,6 +5,7 @@
 #include <functional>
 #include <iostream>
 #include <set>
+#include <string>
 #include <typeinfo>
 #include <typeindex>
 #include <unordered_map>
@@ -14,8 +15,16 @@
     #include "hot-reload/module_loader.h"
 #endif
 
-using Group = uint16_t;
-using Instance = uint16_t;
+// Define these before including bicycle mango to widen stage ids, ie for groups with more than 65534 instances
+#ifndef MANGO_GROUP_TYPE
+    #define MANGO_GROUP_TYPE uint16_t
+#endif
+#ifndef MANGO_INSTANCE_TYPE
+    #define MANGO_INSTANCE_TYPE uint16_t
+#endif
+
+using Group = MANGO_GROUP_TYPE;
+using Instance = MANGO_INSTANCE_TYPE;
 
 static constexpr inline Group group_none = -1;
 static constexpr inline Instance instance_none = -1;
@@ -44,11 +53,14 @@ struct SunLambda // λ
     using Id = std::size_t;
     using Caller = void (*)(const SunLambda&);
     using JoltCaller = void(*)(const SunLambda&, std::vector<size_t>);
+    // Called once with tupleCount tuples of PropIdRaw laid out back to back
+    using JoltBatchCaller = void(*)(const SunLambda&, const size_t* sunData, size_t tupleCount);
     using Functor = void*;
 
     Id id;
     Caller caller = nullptr;
     JoltCaller jolt; // PropIdRaw
+    JoltBatchCaller batchJolt = nullptr;
     Functor functor = nullptr;
     const char* name = nullptr;
 
@@ -72,8 +84,20 @@ struct SunLambda // λ
     {
         (*jolt)(*this, sunData);
     }
+
+    void EmergeBatch(const size_t* sunData, size_t tupleCount) const
+    {
+        (*batchJolt)(*this, sunData, tupleCount);
+    }
+
+    void BreakupBatch(const size_t* sunData, size_t tupleCount) const
+    {
+        (*batchJolt)(*this, sunData, tupleCount);
+    }
 };
 
+static constexpr inline SunLambda::Id sun_lambda_none = -1;
+
 class SunLambdaRegistry
 {
 public:
@@ -96,6 +120,9 @@ public:
 
     SunLambda& Get(SunLambda::Id id)
     {
+        // Registered SunLambdas are found without modifying the map, so worlds on different threads can look them up
+        auto it = sunLambdas.find(id);
+        if (it != sunLambdas.end()) return it->second;
         return sunLambdas[id];
     }
 
@@ -106,12 +133,36 @@ public:
     }
 
 #ifdef HOT_RELOAD
+    // A shared object holding some of the SunLambdas (ie one SunLambda or one source file) that is rebuilt and reloaded on its own
+    // With GCC build modules with -fno-gnu-unique, otherwise the inline statics they pull in keep dlclose from ever unloading them
+    struct LambdaModule
+    {
+        std::string path;
+        std::string target;
+        Module module;
+    };
+
+    void DefineModule(const std::string& name, const std::string& path, const std::string& target)
+    {
+        lambdaModules[name] = {path, target, {}};
+    }
+
+    // SunLambdas that aren't assigned to a module live in HOT_RELOAD_LIB
+    void AssignModule(SunLambda::Id id, const std::string& name)
+    {
+        moduleOf[id] = name;
+    }
+
     void Unload()
     {
         if(module.IsValid())
         {
             module.Unload();
         }
+        for(auto& [name, lambdaModule] : lambdaModules)
+        {
+            Unload(name);
+        }
     }
 
     void Reload()
@@ -122,8 +173,45 @@ public:
 
         for(auto& [id, lambda] : sunLambdas)
         {
+            if(moduleOf.count(id)) continue;
             lambda.functor = module.GetFunction(lambda.name + std::string("_Act"));
         }
+        for(auto& [name, lambdaModule] : lambdaModules)
+        {
+            Reload(name);
+        }
+    }
+
+    void Unload(const std::string& name)
+    {
+        auto found = lambdaModules.find(name);
+        if(found != lambdaModules.end() && found->second.module.IsValid())
+        {
+            found->second.module.Unload();
+        }
+    }
+
+    // Only the functors of SunLambdas assigned to the module are rebound, false if no module was defined with this name
+    bool Reload(const std::string& name)
+    {
+        auto found = lambdaModules.find(name);
+        if(found == lambdaModules.end())
+        {
+            std::cout << "No SunLambda module named " << name << std::endl;
+            return false;
+        }
+        Unload(name);
+        LambdaModule& lambdaModule = found->second;
+        std::cout << lambdaModule.path << std::endl;
+        lambdaModule.module = Module::Load(lambdaModule.path);
+
+        for(auto& [id, moduleName] : moduleOf)
+        {
+            if(moduleName != name) continue;
+            SunLambda& lambda = Get(id);
+            lambda.functor = lambdaModule.module.GetFunction(lambda.name + std::string("_Act"));
+        }
+        return true;
     }
 #endif
 
@@ -132,6 +220,8 @@ public:
 
 #ifdef HOT_RELOAD
     Module module;
+    std::unordered_map<std::string, LambdaModule> lambdaModules;
+    std::unordered_map<SunLambda::Id, std::string> moduleOf;
 #endif
 };
 
@@ -145,6 +235,14 @@ public:
     #endif
 #endif
 
+#ifndef HOT_RELOAD
+    // Static pipelines call the SunLambda directly so it can be inlined into the frame
+    #define SUN_STATIC_ACT(STATIC_CALL) STATIC_CALL
+#else
+    // Hot reloaded SunLambdas live in a module that can be swapped, so static pipelines still call them through the registry
+    #define SUN_STATIC_ACT(STATIC_CALL) SunLambdaRegistry::GetInstance().Get(Id())()
+#endif
+
 #define DeclareSunLambda(LAMBDA_NAME, ...)      \
 \
 SUN_EXPORT void LAMBDA_NAME ## _Act(__VA_ARGS__);      \
@@ -158,18 +256,65 @@ inline void LAMBDA_NAME ## _TypesetCaller(const SunLambda& lambda, std::vector<s
 {\
     mango::CallJolt<__VA_ARGS__>(reinterpret_cast<void (*)(__VA_ARGS__)>(lambda.functor), lambda.id, sunData);\
 }\
+\
+inline void LAMBDA_NAME ## _BatchTypesetCaller(const SunLambda& lambda, const size_t* sunData, size_t tupleCount)\
+{\
+    mango::CallJoltBatch<__VA_ARGS__>(reinterpret_cast<void (*)(__VA_ARGS__)>(lambda.functor), sunData, tupleCount);\
+}\
+struct LAMBDA_NAME : SunLambda               \
+{                                             \
+    LAMBDA_NAME()                              \
+    {                                           \
+        caller = &LAMBDA_NAME ## _Caller;          \
+        jolt = &LAMBDA_NAME ## _TypesetCaller;\
+        batchJolt = &LAMBDA_NAME ## _BatchTypesetCaller;\
+        functor = reinterpret_cast<void*>(&LAMBDA_NAME ## _Act);          \
+        name = #LAMBDA_NAME;                      \
+        SunLambda::id = LAMBDA_NAME::Id();         \
+        mango::ConsiderTypeset<__VA_ARGS__>(Id());\
+    };                                              \
+    static Id Id(){ return std::type_index(typeid(LAMBDA_NAME)).hash_code(); } \
+    static void StaticAct(){ SUN_STATIC_ACT((mango::IterateStatic<&LAMBDA_NAME ## _Act>(Id()))); } \
+    static const inline int ForceInit = (SunLambdaRegistry::GetInstance().Register<LAMBDA_NAME>(), 0); \
+};
+
+// A SunLambda that acts on blocks of tuples with one contiguous column per parameter so that it can be vectorized
+// Its _Act is declared as void(size_t count, PType0* column0, PType1* column1...) where each column keeps the constness of its parameter
+// Each row of a column is a copy, so writes to a partial static that is shared by several rows of a block keep only the last row's value; take partial statics by const
+// With mango::BatchJolts its jolts are called once per frame with every tuple that emerged or broke up, count can then exceed the block size
+#define DeclareBatchSunLambda(LAMBDA_NAME, ...)      \
+\
+using LAMBDA_NAME ## _Signature = mango::BatchSignature<__VA_ARGS__>;      \
+SUN_EXPORT LAMBDA_NAME ## _Signature LAMBDA_NAME ## _Act;      \
+\
+inline void LAMBDA_NAME ## _Caller(const SunLambda& lambda) \
+{\
+   mango::IterateBatch<__VA_ARGS__>(reinterpret_cast<LAMBDA_NAME ## _Signature*>(lambda.functor), lambda.id);\
+}      \
+\
+inline void LAMBDA_NAME ## _TypesetCaller(const SunLambda& lambda, std::vector<size_t> sunData)\
+{\
+    mango::CallBatchJolt<__VA_ARGS__>(reinterpret_cast<LAMBDA_NAME ## _Signature*>(lambda.functor), sunData.data(), 1);\
+}\
+\
+inline void LAMBDA_NAME ## _BatchTypesetCaller(const SunLambda& lambda, const size_t* sunData, size_t tupleCount)\
+{\
+    mango::CallBatchJolt<__VA_ARGS__>(reinterpret_cast<LAMBDA_NAME ## _Signature*>(lambda.functor), sunData, tupleCount);\
+}\
 struct LAMBDA_NAME : SunLambda               \
 {                                             \
     LAMBDA_NAME()                              \
     {                                           \
         caller = &LAMBDA_NAME ## _Caller;          \
         jolt = &LAMBDA_NAME ## _TypesetCaller;\
+        batchJolt = &LAMBDA_NAME ## _BatchTypesetCaller;\
         functor = reinterpret_cast<void*>(&LAMBDA_NAME ## _Act);          \
         name = #LAMBDA_NAME;                      \
         SunLambda::id = LAMBDA_NAME::Id();         \
         mango::ConsiderTypeset<__VA_ARGS__>(Id());\
     };                                              \
     static Id Id(){ return std::type_index(typeid(LAMBDA_NAME)).hash_code(); } \
+    static void StaticAct(){ SUN_STATIC_ACT((mango::IterateBatchStatic<&LAMBDA_NAME ## _Act, __VA_ARGS__>(Id()))); } \
     static const inline int ForceInit = (SunLambdaRegistry::GetInstance().Register<LAMBDA_NAME>(), 0); \
 };
 
@@ -0,0 +1,54 @@
+/*
+ * Live view of the stats a game publishes with mango::OpenStats
+ * Build: g++ -std=c++17 tools/mango_stats.cpp -o mango_stats (add -lrt on older glibc)
+ * Usage: mango_stats [segment name] [refresh milliseconds]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "../utils/stats_segment.h"
+
+static void PrintTable(const char* title, const char* unit, const StatsSegment::Table& table)
+{
+	std::printf("\n%s\n", title);
+	for(uint32_t e = 0; e < table.count && e < StatsSegment::MaxEntries; e++)
+	{
+		const StatsSegment::Entry& entry = table.entries[e];
+		std::printf("  %-48.*s %12llu %s\n", int(StatsSegment::NameSize), entry.name, static_cast<unsigned long long>(entry.value), unit);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string name = argc > 1 ? argv[1] : "/bicycle_mango";
+	const int refresh = argc > 2 ? std::atoi(argv[2]) : 500;
+
+	StatsSegment segment;
+	StatsSegment::Snapshot snapshot;
+	while(true)
+	{
+		// The game may not have opened the segment yet
+		if(!segment.IsValid()) segment = StatsSegment::Open(name);
+		if(segment.IsValid() && segment.Read(snapshot))
+		{
+			std::printf("\033[H\033[2J");
+			std::printf("Frame %llu: %llu us, %llu searches, %llu staged, %llu matched\n",
+				static_cast<unsigned long long>(snapshot.frame), static_cast<unsigned long long>(snapshot.frameMicroseconds),
+				static_cast<unsigned long long>(snapshot.searches), static_cast<unsigned long long>(snapshot.staged),
+				static_cast<unsigned long long>(snapshot.matched));
+			PrintTable("SunLambdas", "ns", snapshot.lambdas);
+			PrintTable("Props", "props", snapshot.props);
+			PrintTable("Staging", "props", snapshot.staging);
+			std::fflush(stdout);
+		}
+		else if(!segment.IsValid())
+		{
+			std::printf("\033[H\033[2JWaiting for %s\n", name.c_str());
+			std::fflush(stdout);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(refresh));
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#if __has_include(<bit>)
+	#include <bit>
+#endif
+#if !defined(__cpp_lib_bitops) && defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+// The index of the lowest set bit of a word that isn't zero
+inline unsigned LowestSetBit(uint64_t word)
+{
+#if defined(__cpp_lib_bitops)
+	return static_cast<unsigned>(std::countr_zero(word));
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "bit_scan.h"
+
+// A growable set of ids packed into 64 bit words
+class DynamicBitset
+{
+public:
+	using Word = uint64_t;
+	static constexpr size_t WordBits = sizeof(Word) * 8;
+
+	void set(size_t index)
+	{
+		const size_t word = index / WordBits;
+		if(word >= words.size())
+		{
+			words.resize(word + 1, 0);
+		}
+		words[word] |= Word(1) << (index % WordBits);
+	}
+
+	void reset(size_t index)
+	{
+		const size_t word = index / WordBits;
+		if(word < words.size())
+		{
+			words[word] &= ~(Word(1) << (index % WordBits));
+		}
+	}
+
+	bool test(size_t index) const
+	{
+		const size_t word = index / WordBits;
+		return word < words.size() && (words[word] >> (index % WordBits)) & 1;
+	}
+
+	bool any() const
+	{
+		for(Word word : words)
+		{
+			if(word) return true;
+		}
+		return false;
+	}
+
+	// Keeps the allocated words around so the next frame doesn't pay for growth again
+	void clear()
+	{
+		std::fill(words.begin(), words.end(), 0);
+	}
+
+	// Calls visit with the index of every set bit in ascending order
+	template<typename Visit>
+	void forEach(Visit visit) const
+	{
+		for(size_t w = 0; w < words.size(); w++)
+		{
+			for(Word word = words[w]; word; word &= word - 1)
+			{
+				visit(w * WordBits + LowestSetBit(word));
+			}
+		}
+	}
+
+	size_t size() const
+	{
+		return words.size() * WordBits;
+	}
+
+	std::vector<Word> words;
+};
@@ -1,12 +1,35 @@
 #pragma once
 
-template<typename T = size_t, bool Reuse = true>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "bit_scan.h"
+
+/*
+ * Hands out ids counting up from 0
+ * With Reuse freed ids are handed out again, the most recently freed one first
+ * With Lowest the freed ids are kept in a bitmap and the lowest one is handed out first so that ids stay dense
+ */
+template<typename T = size_t, bool Reuse = true, bool Lowest = false>
 class IdPool
 {
 public:
+	// The largest id is left unused so that it can mean no id, ie instance_none
+	static constexpr T none = std::numeric_limits<T>::max();
+
 	T next()
 	{
-		if constexpr(Reuse)
+		if constexpr(Reuse && Lowest)
+		{
+			if(freeCount > 0)
+			{
+				return take(lowestFree());
+			}
+		}
+		else if constexpr(Reuse)
 		{
 			if(freeIds.size() > 0)
 			{
@@ -16,18 +39,126 @@ public:
 			}
 		}
 
+		if(nextId == none)
+		{
+			throw std::overflow_error("IdPool ran out of ids, use a wider id type");
+		}
 		return nextId++;
 	}
 
 	void free(T id)
 	{
-		if constexpr(Reuse)
+		if constexpr(Reuse && Lowest)
+		{
+			if(isFree(id)) return;
+			const size_t word = id / WordBits;
+			if(word >= freeBits.size())
+			{
+				freeBits.resize(word + 1, 0);
+				freeWords.resize(word / WordBits + 1, 0);
+			}
+			freeBits[word] |= Word(1) << (id % WordBits);
+			freeWords[word / WordBits] |= Word(1) << (word % WordBits);
+			freeCount++;
+		}
+		else if constexpr(Reuse)
 		{
 			freeIds.push_back(id);
 		}
 	}
 
+	// Mark an id chosen elsewhere as used, ie a stage read back from a journal
+	// Ids skipped over become free rather than being lost
+	void claim(T id)
+	{
+		if(id >= none)
+		{
+			throw std::out_of_range("IdPool can't claim its none id");
+		}
+		if(id >= nextId)
+		{
+			for(T skipped = nextId; skipped < id; skipped++)
+			{
+				free(skipped);
+			}
+			nextId = id + 1;
+			return;
+		}
+		if constexpr(Reuse && Lowest)
+		{
+			if(isFree(id)) take(id);
+		}
+		else if constexpr(Reuse)
+		{
+			for(size_t i = 0; i < freeIds.size(); i++)
+			{
+				if(freeIds[i] == id)
+				{
+					freeIds.erase(freeIds.begin() + i);
+					break;
+				}
+			}
+		}
+	}
+
+	bool isFree(T id) const
+	{
+		const size_t word = id / WordBits;
+		return word < freeBits.size() && (freeBits[word] >> (id % WordBits)) & 1;
+	}
+
+	size_t live() const
+	{
+		return nextId - (Lowest ? freeCount : freeIds.size());
+	}
+
+	size_t bytes() const
+	{
+		return freeIds.capacity() * sizeof(T) + (freeBits.capacity() + freeWords.capacity()) * sizeof(Word);
+	}
+
+	// Forget every id but keep the memory for the next batch
+	void reset()
+	{
+		nextId = 0;
+		freeIds.clear();
+		std::fill(freeBits.begin(), freeBits.end(), 0);
+		std::fill(freeWords.begin(), freeWords.end(), 0);
+		freeCount = 0;
+	}
+
+private:
+	using Word = uint64_t;
+	static constexpr size_t WordBits = sizeof(Word) * 8;
+
+	// freeWords has a bit for each word of freeBits with a free id, so finding the lowest free id skips 4096 ids per word read
+	T lowestFree() const
+	{
+		for(size_t summary = 0; summary < freeWords.size(); summary++)
+		{
+			if(!freeWords[summary]) continue;
+			const size_t word = summary * WordBits + LowestSetBit(freeWords[summary]);
+			return static_cast<T>(word * WordBits + LowestSetBit(freeBits[word]));
+		}
+		return nextId;
+	}
+
+	T take(T id)
+	{
+		const size_t word = id / WordBits;
+		freeBits[word] &= ~(Word(1) << (id % WordBits));
+		if(!freeBits[word])
+		{
+			freeWords[word / WordBits] &= ~(Word(1) << (word % WordBits));
+		}
+		freeCount--;
+		return id;
+	}
+
 public:
 	T nextId = 0;
-	std::vector<T> freeIds;	
+	std::vector<T> freeIds;
+	std::vector<Word> freeBits;
+	std::vector<Word> freeWords;
+	size_t freeCount = 0;
 };
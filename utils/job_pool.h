@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed set of worker threads that run jobs in the order they were pushed
+ * The workers are only started by the first job, so a pool that is never used costs nothing
+ */
+class JobPool
+{
+public:
+	void push(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(workers.empty()) start();
+			jobs.push_back(std::move(job));
+			pending++;
+		}
+		signal.notify_one();
+	}
+
+	// One pool for the whole process, so that many worlds don't each start a thread per core
+	static JobPool& shared()
+	{
+		static JobPool pool;
+		return pool;
+	}
+
+	// Blocks until every job pushed so far has finished
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]{ return pending == 0; });
+	}
+
+	~JobPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		signal.notify_all();
+		for(std::thread& worker : workers) worker.join();
+	}
+
+private:
+	void start()
+	{
+		// One core is left to the thread running the loop
+		const size_t count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		for(size_t w = 0; w < count; w++)
+		{
+			workers.emplace_back([this]{ work(); });
+		}
+	}
+
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true)
+		{
+			signal.wait(lock, [this]{ return stopping || !jobs.empty(); });
+			if(jobs.empty()) return;
+			std::function<void()> job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+			job();
+			lock.lock();
+			if(--pending == 0) finished.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	size_t pending = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable signal;
+	std::condition_variable finished;
+};
+
+/*
+ * The jobs one owner pushed to a pool that others push to as well
+ * wait only blocks until this group's jobs are done, not the rest of the pool's
+ */
+class JobGroup
+{
+public:
+	void push(JobPool& pool, std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending++;
+		}
+		pool.push([this, job = std::move(job)]
+		{
+			job();
+			// Notified under the lock so that a waiter can't destroy the group before we're done with it
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--pending == 0) finished.notify_all();
+		});
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]{ return pending == 0; });
+	}
+
+	~JobGroup()
+	{
+		wait();
+	}
+
+private:
+	size_t pending = 0;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "id_pool.h"
+
+/*
+ * A SparseArray alternative built from fixed size pages that are never moved once allocated
+ * Pointers to elements stay valid for the lifetime of the element no matter how much the array grows
+ * Every page is aligned to its own (power of two) size so the page header of any element can be found by masking its address
+ * Pages hold at least MinPageSize elements, and as many more as fill the power of two so that less than one element's worth of each page is wasted
+ */
+template<typename T, typename Id = size_t, size_t MinPageSize = 256>
+class PagedArray
+{
+	using Slot = std::optional<T>;
+
+	// The header rounded up to the alignment of the slots that follow it
+	static constexpr size_t HeaderSize = (sizeof(Id) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+	static constexpr size_t PageBytes()
+	{
+		size_t bytes = std::max(alignof(Id), alignof(Slot));
+		while(bytes < HeaderSize + MinPageSize * sizeof(Slot)) bytes *= 2;
+		return bytes;
+	}
+
+public:
+	static constexpr size_t PageSize = (PageBytes() - HeaderSize) / sizeof(Slot);
+
+	struct Page
+	{
+		// The id of the first slot, read back through the header when finding the id of an element from its address
+		Id first;
+		Slot slots[PageSize];
+	};
+	static_assert(sizeof(Page) <= PageBytes(), "A page must fit in its power of two");
+
+	static constexpr size_t PageAlignment()
+	{
+		return PageBytes();
+	}
+
+	std::pair<Id, T&> next()
+	{
+		const Id id = idPool.next();
+		reserve(id + 1);
+		std::optional<T>& slot = pages[id / PageSize]->slots[id % PageSize];
+		slot.emplace();
+		peak = std::max(peak, live());
+		return {id, slot.value()};
+	}
+
+	void free(Id id)
+	{
+		pages[id / PageSize]->slots[id % PageSize].reset();
+		idPool.free(id);
+	}
+
+	// Allocates pages until n elements fit, existing pages are left where they are
+	void reserve(size_t n)
+	{
+		while(pages.size() * PageSize < n)
+		{
+			Page* page = new (static_cast<std::align_val_t>(PageAlignment())) Page();
+			page->first = static_cast<Id>(pages.size() * PageSize);
+			pages.push_back(page);
+		}
+	}
+
+	// Drops every element but keeps the pages allocated for the next batch of elements
+	void clear()
+	{
+		for(Page* page : pages)
+		{
+			for(std::optional<T>& slot : page->slots) slot.reset();
+		}
+		idPool.reset();
+	}
+
+	Id idOf(const T* element) const
+	{
+		const uintptr_t address = reinterpret_cast<uintptr_t>(element);
+		const Page* page = reinterpret_cast<const Page*>(address & ~(uintptr_t(PageAlignment()) - 1));
+		const uintptr_t offset = address - reinterpret_cast<uintptr_t>(&page->slots[0]);
+		return page->first + static_cast<Id>(offset / sizeof(std::optional<T>));
+	}
+
+	T& operator[](Id id)
+	{
+		return pages[id / PageSize]->slots[id % PageSize].value();
+	}
+
+	const T& operator[](Id id) const
+	{
+		return pages[id / PageSize]->slots[id % PageSize].value();
+	}
+
+	size_t live() const
+	{
+		return idPool.live();
+	}
+
+	size_t capacity() const
+	{
+		return pages.size() * PageSize;
+	}
+
+	size_t bytes() const
+	{
+		return pages.size() * PageAlignment() + pages.capacity() * sizeof(Page*) + idPool.bytes();
+	}
+
+	PagedArray() = default;
+
+	PagedArray(const PagedArray& other)
+	{
+		*this = other;
+	}
+
+	// Copies element by element into our own pages so that a snapshot reuses its pages every frame
+	PagedArray& operator=(const PagedArray& other)
+	{
+		if(this == &other) return *this;
+		reserve(other.capacity());
+		for(size_t p = 0; p < pages.size(); p++)
+		{
+			for(size_t s = 0; s < PageSize; s++)
+			{
+				if(p < other.pages.size())
+				{
+					pages[p]->slots[s] = other.pages[p]->slots[s];
+				}
+				else
+				{
+					pages[p]->slots[s].reset();
+				}
+			}
+		}
+		idPool = other.idPool;
+		peak = other.peak;
+		return *this;
+	}
+
+	~PagedArray()
+	{
+		for(Page* page : pages)
+		{
+			page->~Page();
+			::operator delete(page, static_cast<std::align_val_t>(PageAlignment()));
+		}
+	}
+
+	std::vector<Page*> pages;
+	// Lowest free ids keep props packed at the front of the array
+	IdPool<Id, true, true> idPool;
+	// The most elements that have been alive at once
+	size_t peak = 0;
+};
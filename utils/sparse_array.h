@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
 #include "id_pool.h"
 
 template<typename T, typename Id = size_t>
@@ -84,6 +89,7 @@ public:
             buffer.resize(id + 2);
 		}
         buffer[id] = T();
+		peak = std::max(peak, live());
 		return {id, buffer[id].value()};
 	}
 
@@ -92,11 +98,47 @@ public:
 		idPool.free(id);
 	}
 
+	// The element lives inside an optional, so the slot stride includes the engaged flag and its padding
+	Id idOf(const T* element) const
+	{
+		const uintptr_t offset = reinterpret_cast<uintptr_t>(element) - reinterpret_cast<uintptr_t>(buffer.data());
+		return static_cast<Id>(offset / sizeof(std::optional<T>));
+	}
+
 	SparseArray()
 	{
 		buffer.resize(1);
 	}
 
+	// Make room for n props so that spawning them doesn't reallocate and copy every prop
+	void reserve(size_t n)
+	{
+		buffer.reserve(n + 1);
+	}
+
+	// Drops every element but keeps the buffer allocated for the next batch of props
+	void clear()
+	{
+		buffer.clear();
+		buffer.resize(1);
+		idPool.reset();
+	}
+
+	size_t live() const
+	{
+		return idPool.live();
+	}
+
+	size_t capacity() const
+	{
+		return buffer.capacity() - 1;
+	}
+
+	size_t bytes() const
+	{
+		return buffer.capacity() * sizeof(std::optional<T>) + idPool.bytes();
+	}
+
 	T& operator[](Id id)
 	{
 		return buffer[id].value();
@@ -108,5 +150,8 @@ public:
 	}
 
 	std::vector<std::optional<T>> buffer;
-	IdPool<Id, true> idPool;
+	// Lowest free ids keep props packed at the front of the array
+	IdPool<Id, true, true> idPool;
+	// The most props that have been alive at once
+	size_t peak = 0;
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+#ifdef _MSC_VER
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif // _MSC_VER
+
+/*
+ * A named shared memory segment one process writes stats to and any number of processes read from
+ * Writes are guarded by a sequence number that is odd while a write is in progress (a seqlock)
+ * The writer never waits, a reader copies the whole layout and retries if the sequence changed under it
+ */
+class StatsSegment
+{
+public:
+	// "MNGO", readers refuse a segment with a different magic or layout version
+	static constexpr uint32_t Magic = 0x4f474e4d;
+	static constexpr uint32_t Version = 1;
+	static constexpr size_t NameSize = 48;
+	static constexpr size_t MaxEntries = 256;
+
+	struct Entry
+	{
+		uint64_t id = 0;
+		uint64_t value = 0;
+		char name[NameSize] = {};
+
+		// The name is only copied when a different id lands in this entry, which keeps a steady frame down to two stores per entry
+		template<typename Name>
+		void set(uint64_t entryId, uint64_t entryValue, Name&& getName)
+		{
+			if(id != entryId || name[0] == '\0')
+			{
+				id = entryId;
+				const std::string_view entryName = getName();
+				const size_t length = std::min(entryName.size(), NameSize - 1);
+				std::memcpy(name, entryName.data(), length);
+				name[length] = '\0';
+			}
+			value = entryValue;
+		}
+	};
+
+	struct Table
+	{
+		uint32_t count = 0;
+		Entry entries[MaxEntries];
+	};
+
+	struct Layout
+	{
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		std::atomic<uint64_t> sequence{0};
+		uint64_t frame = 0;
+		uint64_t frameMicroseconds = 0;
+		uint64_t searches = 0;
+		uint64_t staged = 0;
+		uint64_t matched = 0;
+		// Nanoseconds each SunLambda acted for during the frame
+		Table lambdas;
+		// Live props of each prop type
+		Table props;
+		// Staged props of each SunLambda
+		Table staging;
+	};
+
+	// Readers copy the layout out of the segment, the sequence isn't copyable so it's left out
+	struct Snapshot
+	{
+		uint64_t frame = 0;
+		uint64_t frameMicroseconds = 0;
+		uint64_t searches = 0;
+		uint64_t staged = 0;
+		uint64_t matched = 0;
+		Table lambdas;
+		Table props;
+		Table staging;
+	};
+
+	// Creates (or takes over) the segment for writing
+	static StatsSegment Create(const std::string& name)
+	{
+		StatsSegment segment = Map(name, true);
+		if(segment.layout)
+		{
+			new (segment.layout) Layout();
+			segment.layout->magic = Magic;
+			segment.layout->version = Version;
+		}
+		return segment;
+	}
+
+	// Opens a segment created by another process for reading
+	static StatsSegment Open(const std::string& name)
+	{
+		StatsSegment segment = Map(name, false);
+		if(segment.layout && (segment.layout->magic != Magic || segment.layout->version != Version))
+		{
+			segment.Close();
+		}
+		return segment;
+	}
+
+	bool IsValid() const
+	{
+		return layout;
+	}
+
+	// Every write to the layout must happen between BeginWrite and EndWrite
+	Layout& BeginWrite()
+	{
+		const uint64_t sequence = layout->sequence.load(std::memory_order_relaxed);
+		layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return *layout;
+	}
+
+	void EndWrite()
+	{
+		layout->sequence.store(layout->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// False until the writer has finished its first write, or if it kept writing over every attempt
+	bool Read(Snapshot& snapshot, size_t attempts = 64) const
+	{
+		for(size_t attempt = 0; attempt < attempts; attempt++)
+		{
+			const uint64_t before = layout->sequence.load(std::memory_order_acquire);
+			if(before == 0 || before % 2 == 1) continue;
+			snapshot.frame = layout->frame;
+			snapshot.frameMicroseconds = layout->frameMicroseconds;
+			snapshot.searches = layout->searches;
+			snapshot.staged = layout->staged;
+			snapshot.matched = layout->matched;
+			std::memcpy(&snapshot.lambdas, &layout->lambdas, sizeof(Table));
+			std::memcpy(&snapshot.props, &layout->props, sizeof(Table));
+			std::memcpy(&snapshot.staging, &layout->staging, sizeof(Table));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(layout->sequence.load(std::memory_order_relaxed) == before) return true;
+		}
+		return false;
+	}
+
+	// The writer's segment is removed once it's closed, readers that still have it mapped keep their view
+	void Close()
+	{
+		if(!layout) return;
+#ifdef _MSC_VER
+		UnmapViewOfFile(layout);
+		CloseHandle(static_cast<HANDLE>(handle));
+#else
+		munmap(layout, sizeof(Layout));
+		if(owner) shm_unlink(name.data());
+#endif
+		layout = nullptr;
+	}
+
+private:
+	static StatsSegment Map(const std::string& name, bool create)
+	{
+		StatsSegment segment;
+		segment.name = name;
+		segment.owner = create;
+#ifdef _MSC_VER
+		HANDLE mapping = create
+			? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Layout), name.data())
+			: OpenFileMappingA(FILE_MAP_READ, FALSE, name.data());
+		if(!mapping) return segment;
+		void* view = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(Layout));
+		if(!view)
+		{
+			CloseHandle(mapping);
+			return segment;
+		}
+		segment.handle = mapping;
+		segment.layout = static_cast<Layout*>(view);
+#else
+		const int fd = create ? shm_open(name.data(), O_CREAT | O_RDWR, 0644) : shm_open(name.data(), O_RDONLY, 0);
+		if(fd < 0) return segment;
+		if(create && ftruncate(fd, sizeof(Layout)) != 0)
+		{
+			close(fd);
+			return segment;
+		}
+		void* view = mmap(nullptr, sizeof(Layout), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(view == MAP_FAILED) return segment;
+		segment.layout = static_cast<Layout*>(view);
+#endif
+		return segment;
+	}
+
+	Layout* layout = nullptr;
+	void* handle = nullptr;
+	std::string name;
+	bool owner = false;
+};